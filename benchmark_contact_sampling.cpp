@@ -0,0 +1,239 @@
+#include "src/alias_sampler.hpp"
+#include "src/data.hpp"
+#include "src/road_networks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gsl/gsl_cdf.h>
+
+#include <routingkit/constants.h>
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <stdio.h>
+
+static const unsigned NUM_SOURCES = 200;
+static const unsigned NUM_REPETITIONS = 5;
+static const unsigned NUM_STATISTICAL_DRAWS = 10'000'000;
+static const unsigned NUM_BINS = 32;
+
+// with the fixed seed, a sampler fails if its chi-squared p-value falls below this
+static const double MIN_P_VALUE = 1e-3;
+
+// The contact sampling path Highway used before AliasSampler, except that distances of 0 count as 1, as in
+// compute_power_law_weights; pow(0, -exponent) would give an infinite weight, which it cannot sample from.
+unsigned sample_with_discrete_distribution(const std::vector<unsigned>& distances, unsigned self, double clustering_exponent, unsigned num_draws, std::mt19937& rng)
+{
+	std::vector<double> probabilities;
+
+	for (unsigned i = 0; i < distances.size(); ++i)
+	{
+		probabilities.push_back(i == self ? 0.0 : std::pow(std::max(distances[i], 1u), -clustering_exponent));
+	}
+
+	std::discrete_distribution<unsigned> dist(probabilities.begin(), probabilities.end());
+
+	unsigned checksum = 0;
+	for (unsigned i = 0; i < num_draws; ++i)
+	{
+		checksum += dist(rng);
+	}
+
+	return checksum;
+}
+
+unsigned sample_with_alias_table(const std::vector<unsigned>& distances, unsigned self, double clustering_exponent, unsigned num_draws, std::mt19937& rng)
+{
+	thread_local std::vector<double> weights;
+	thread_local AliasSampler sampler;
+
+	compute_power_law_weights(distances, clustering_exponent, weights);
+	weights[self] = 0.0;
+
+	sampler.build(weights);
+
+	unsigned checksum = 0;
+	for (unsigned i = 0; i < num_draws; ++i)
+	{
+		checksum += sampler(rng);
+	}
+
+	return checksum;
+}
+
+// Pearson's chi-squared goodness of fit of num_draws samples against the exact contact distribution,
+// with the highway nodes grouped into NUM_BINS bins of (roughly) equal probability mass
+template <typename Sampler>
+double chi_squared_p_value(const std::vector<double>& probabilities, unsigned num_draws, Sampler&& sample)
+{
+	std::vector<unsigned> bin_of(probabilities.size());
+	std::vector<double> expected(NUM_BINS, 0.0);
+
+	double cumulative = 0.0;
+	for (unsigned i = 0; i < probabilities.size(); ++i)
+	{
+		bin_of[i] = std::min(static_cast<unsigned>(cumulative * NUM_BINS), NUM_BINS - 1);
+		expected[bin_of[i]] += probabilities[i] * num_draws;
+		cumulative += probabilities[i];
+	}
+
+	std::vector<unsigned> observed(NUM_BINS, 0);
+	for (unsigned i = 0; i < num_draws; ++i)
+	{
+		++observed[bin_of[sample()]];
+	}
+
+	double chi_squared = 0.0;
+	unsigned degrees_of_freedom = 0;
+	for (unsigned b = 0; b < NUM_BINS; ++b)
+	{
+		if (expected[b] == 0.0)
+		{
+			continue;
+		}
+
+		chi_squared += (observed[b] - expected[b]) * (observed[b] - expected[b]) / expected[b];
+		++degrees_of_freedom;
+	}
+
+	return gsl_cdf_chisq_Q(chi_squared, degrees_of_freedom - 1);
+}
+
+// the exact contact distribution of a highway node with the given distances, whose own index is self
+std::vector<double> contact_probabilities(const std::vector<unsigned>& distances, unsigned self, double clustering_exponent)
+{
+	std::vector<double> probabilities(distances.size());
+	for (unsigned i = 0; i < distances.size(); ++i)
+	{
+		probabilities[i] = i == self ? 0.0 : std::pow(std::max(distances[i], 1u), -clustering_exponent);
+	}
+
+	double total = 0.0;
+	for (double p : probabilities)
+	{
+		total += p;
+	}
+
+	for (double& p : probabilities)
+	{
+		p /= total;
+	}
+
+	return probabilities;
+}
+
+// Highway nodes at distance 0 from each other get weight 1, as if they were at distance 1, rather than the infinite
+// weight pow would give them. Checks the weights of a row with such distances, and that the alias table draws them.
+bool check_zero_distances(double clustering_exponent, std::mt19937& rng)
+{
+	std::vector<unsigned> distances = { 0, 0, 1, 2, 10, 1000, 0, RoutingKit::inf_weight };
+	unsigned self = 0;
+
+	std::vector<double> weights;
+	compute_power_law_weights(distances, clustering_exponent, weights);
+
+	bool weights_match = true;
+	for (unsigned i = 0; i < distances.size(); ++i)
+	{
+		double expected = std::pow(std::max(distances[i], 1u), -clustering_exponent);
+		weights_match = weights_match && std::isfinite(weights[i]) && std::abs(weights[i] - expected) <= 1e-12 * expected;
+	}
+
+	weights[self] = 0.0;
+	AliasSampler alias;
+	alias.build(weights);
+
+	auto probabilities = contact_probabilities(distances, self, clustering_exponent);
+	double p_value = chi_squared_p_value(probabilities, NUM_STATISTICAL_DRAWS, [&]() { return alias(rng); });
+
+	bool passed = weights_match && p_value >= MIN_P_VALUE;
+	printf("distance 0 as weight 1: weights %s, chi-squared p = %.4f: %s\n", weights_match ? "match" : "differ", p_value, passed ? "PASSED" : "FAILED");
+
+	return passed;
+}
+
+int main(int argc, char* argv[])
+{
+	double clustering_exponent = argc > 1 ? std::stod(argv[1]) : 1.5;
+
+	WallTimer timer;
+	std::mt19937 rng(12345);
+
+	bool all_passed = check_zero_distances(clustering_exponent, rng);
+
+	for (const auto& state : get_state_names())
+	{
+		auto ch = get_contraction_hierarchy(state);
+		unsigned k = std::lround(std::log2(ch.node_count()));
+
+		std::bernoulli_distribution is_highway(1.0 / k);
+		std::vector<unsigned> highway_nodes;
+		for (unsigned node = 0; node < ch.node_count(); ++node)
+		{
+			if (is_highway(rng))
+			{
+				highway_nodes.push_back(node);
+			}
+		}
+
+		// the one-to-many CH query is shared by both paths, so it is kept out of the timings
+		RoutingKit::ContractionHierarchyQuery ch_query(ch);
+		std::vector<std::vector<unsigned>> distances;
+		std::vector<unsigned> sources;
+		std::uniform_int_distribution<unsigned> pick(0, highway_nodes.size() - 1);
+		for (unsigned i = 0; i < NUM_SOURCES; ++i)
+		{
+			sources.push_back(pick(rng));
+			distances.push_back(ch_query.reset().add_source(highway_nodes[sources.back()]).pin_targets(highway_nodes).run_to_pinned_targets().get_distances_to_targets());
+		}
+
+		unsigned checksum = 0;
+
+		timer.start();
+		for (unsigned r = 0; r < NUM_REPETITIONS; ++r)
+		{
+			for (unsigned i = 0; i < NUM_SOURCES; ++i)
+			{
+				checksum += sample_with_discrete_distribution(distances[i], sources[i], clustering_exponent, k, rng);
+			}
+		}
+		double discrete_nanoseconds = static_cast<double>(timer.elapsed_nanoseconds()) / (NUM_REPETITIONS * NUM_SOURCES);
+
+		timer.start();
+		for (unsigned r = 0; r < NUM_REPETITIONS; ++r)
+		{
+			for (unsigned i = 0; i < NUM_SOURCES; ++i)
+			{
+				checksum += sample_with_alias_table(distances[i], sources[i], clustering_exponent, k, rng);
+			}
+		}
+		double alias_nanoseconds = static_cast<double>(timer.elapsed_nanoseconds()) / (NUM_REPETITIONS * NUM_SOURCES);
+
+		// goodness of fit of both samplers against the exact distribution of the first source
+		auto probabilities = contact_probabilities(distances[0], sources[0], clustering_exponent);
+
+		std::discrete_distribution<unsigned> discrete(probabilities.begin(), probabilities.end());
+		double discrete_p_value = chi_squared_p_value(probabilities, NUM_STATISTICAL_DRAWS, [&]() { return discrete(rng); });
+
+		std::vector<double> weights;
+		AliasSampler alias;
+		compute_power_law_weights(distances[0], clustering_exponent, weights);
+		weights[sources[0]] = 0.0;
+		alias.build(weights);
+		double alias_p_value = chi_squared_p_value(probabilities, NUM_STATISTICAL_DRAWS, [&]() { return alias(rng); });
+
+		printf("%s: %zu highway nodes, %u draws per visit (checksum %u)\n", state.c_str(), highway_nodes.size(), k, checksum);
+		printf("\tdiscrete_distribution: %.0f ns per visit, chi-squared p = %.4f\n", discrete_nanoseconds, discrete_p_value);
+		printf("\talias table:           %.0f ns per visit, chi-squared p = %.4f\n", alias_nanoseconds, alias_p_value);
+		printf("\tspeedup: %.2fx\n", discrete_nanoseconds / alias_nanoseconds);
+
+		all_passed = all_passed && discrete_p_value >= MIN_P_VALUE && alias_p_value >= MIN_P_VALUE;
+	}
+
+	printf("%s\n", all_passed ? "PASSED" : "FAILED");
+
+	return all_passed ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include "src/data.hpp"
+#include "src/highway.hpp"
+#include "src/landmarks.hpp"
+#include "src/road_networks.hpp"
+
+#include <cmath>
+#include <string>
+
+#include <stdio.h>
+
+static const unsigned NUM_BATCHES = 10;
+static const unsigned BATCH_SIZE = 1000;
+
+// CH_QUERIES routing with and without landmark bounds: both see the same highway and trials, so the totals must agree
+int main(int argc, char* argv[])
+{
+	std::string state = argc > 1 ? argv[1] : "DE";
+
+	WallTimer timer;
+
+	timer.start("Loading contraction hierarchy for " + state);
+
+	auto ch = get_contraction_hierarchy(state);
+
+	timer.print();
+
+	timer.start("Choosing landmarks for " + state);
+
+	Landmarks landmarks(ch);
+
+	timer.print();
+
+	unsigned k = std::lround(std::log2(ch.node_count()));
+
+	HighwayOptions options;
+	options.greedy_routing = GreedyRouting::CH_QUERIES;
+	options.seed = 1;
+
+	Highway exact(state, ch, k, 1, 1.5, options);
+
+	options.landmarks = &landmarks;
+	Highway bounded(state, ch, k, 1, 1.5, options);
+
+	printf("batch, exact time, landmark time, speedup, avoided queries per hop, same total\n");
+
+	for (unsigned batch = 0; batch < NUM_BATCHES; ++batch)
+	{
+		exact.initialize();
+		bounded.initialize();
+
+		WallTimer exact_timer;
+		exact_timer.start();
+		double exact_total = exact.get_total_greedy_path_length(BATCH_SIZE);
+		double exact_nanoseconds = exact_timer.elapsed_nanoseconds();
+
+		WallTimer bounded_timer;
+		bounded_timer.start();
+		double bounded_total = bounded.get_total_greedy_path_length(BATCH_SIZE);
+		double bounded_nanoseconds = bounded_timer.elapsed_nanoseconds();
+
+		printf("%u, %s, %s, %.2fx, %f, %s\n", batch, pretty_print(exact_nanoseconds).c_str(), pretty_print(bounded_nanoseconds).c_str(),
+			exact_nanoseconds / bounded_nanoseconds, bounded.get_avoided_queries_per_hop(), exact_total == bounded_total ? "yes" : "NO");
+	}
+
+	return 0;
+}
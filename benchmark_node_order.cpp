@@ -0,0 +1,182 @@
+#include "src/data.hpp"
+#include "src/graph.hpp"
+#include "src/highway.hpp"
+#include "src/node_order.hpp"
+#include "src/road_networks.hpp"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdio.h>
+
+static const unsigned NUM_SOURCES = 20;
+static const unsigned NUM_TRIALS = 1000;
+
+// Last-level cache misses of the calling thread, from the hardware counter; unavailable inside most containers
+// and VMs, or if perf_event_paranoid forbids it. Only the calling thread is counted, so everything measured runs on it.
+class CacheMissCounter
+{
+public:
+	CacheMissCounter()
+	{
+		perf_event_attr attributes = {};
+		attributes.type = PERF_TYPE_HARDWARE;
+		attributes.size = sizeof(attributes);
+		attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+
+		_fd = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+	}
+
+	~CacheMissCounter()
+	{
+		if (_fd >= 0)
+		{
+			close(_fd);
+		}
+	}
+
+	CacheMissCounter(const CacheMissCounter&) = delete;
+	CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+	void start() noexcept
+	{
+		if (_fd >= 0)
+		{
+			ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+
+	// "n/a" if the counter could not be opened
+	std::string stop() noexcept
+	{
+		uint64_t misses = 0;
+
+		if (_fd < 0)
+		{
+			return "n/a";
+		}
+
+		ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+		if (read(_fd, &misses, sizeof(misses)) != sizeof(misses))
+		{
+			return "n/a";
+		}
+
+		return std::to_string(misses);
+	}
+
+private:
+	int _fd;
+};
+
+// Ball growth and greedy routing under every node ordering, from the same sources and between the same endpoints,
+// given by their original numbers and translated with position. Both run on the calling thread, so that the cache
+// misses counted are exactly theirs.
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> states;
+	for (int i = 1; i < argc; ++i)
+	{
+		states.push_back(argv[i]);
+	}
+
+	if (states.empty())
+	{
+		states = { "CA", "TX", "FL" };
+	}
+
+	CacheMissCounter counter;
+
+	printf("state, ordering, balls time, balls cache misses, routing time, routing cache misses, average path length\n");
+
+	for (const auto& state : states)
+	{
+		auto graph = get_graph(state);
+		unsigned num_nodes = graph.size();
+
+		std::mt19937 rng(12345);
+		std::uniform_int_distribution<unsigned> random_node(0, num_nodes - 1);
+
+		// trials only run between nodes of the largest component, as in Highway::get_total_greedy_path_length
+		auto random_trial_node = [&]()
+		{
+			unsigned u;
+			do
+			{
+				u = random_node(rng);
+			} while (graph.component(u) != 0);
+
+			return u;
+		};
+
+		std::vector<unsigned> sources(NUM_SOURCES);
+		for (auto& source : sources)
+		{
+			source = random_node(rng);
+		}
+
+		std::vector<std::pair<unsigned, unsigned>> endpoints(NUM_TRIALS);
+		for (auto& [start, end] : endpoints)
+		{
+			start = random_trial_node();
+			end = random_trial_node();
+		}
+
+		for (auto ordering : { NodeOrdering::ORIGINAL, NodeOrdering::BREADTH_FIRST, NodeOrdering::HILBERT, NodeOrdering::CONTRACTION_RANK })
+		{
+			auto network = get_renumbered_network(state, ordering);
+
+			std::vector<Ball> balls;
+			WallTimer timer;
+
+			timer.start();
+			counter.start();
+			for (unsigned source : sources)
+			{
+				network.graph.get_balls(network.position[source], balls);
+			}
+			std::string balls_misses = counter.stop();
+			double balls_nanoseconds = timer.elapsed_nanoseconds();
+
+			HighwayOptions options;
+			options.components = network.graph.components();
+			options.seed = 1;
+
+			unsigned k = std::lround(std::log2(num_nodes));
+			Highway highway(state, network.contraction_hierarchy, k, 1, 1.5, options);
+			highway.initialize();
+
+			double total = 0.0;
+
+			timer.start();
+			counter.start();
+			for (unsigned trial = 0; trial < NUM_TRIALS; ++trial)
+			{
+				auto [start, end] = endpoints[trial];
+				total += highway.get_greedy_path_length(network.position[start], network.position[end], trial);
+			}
+			std::string routing_misses = counter.stop();
+			double routing_nanoseconds = timer.elapsed_nanoseconds();
+
+			printf("%s, %s, %s, %s, %s, %s, %f\n", state.c_str(), to_string(ordering), pretty_print(balls_nanoseconds).c_str(), balls_misses.c_str(),
+				pretty_print(routing_nanoseconds).c_str(), routing_misses.c_str(), total / NUM_TRIALS);
+			fflush(stdout);
+		}
+	}
+
+	return 0;
+}
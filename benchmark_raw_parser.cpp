@@ -0,0 +1,79 @@
+#include "src/data.hpp"
+#include "src/graph.hpp"
+#include "src/road_networks.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdio.h>
+
+static const unsigned NUM_REPETITIONS = 5;
+
+// the .raw loader get_graph used before parse_raw_graph
+Graph parse_raw_graph_with_ifstream(const std::string& path)
+{
+	std::ifstream file(path);
+
+	unsigned num_nodes;
+	file >> num_nodes;
+
+	GraphBuilder builder(num_nodes);
+
+	unsigned u, v;
+	double weight;
+	while (file >> u >> v >> weight)
+	{
+		builder.add_edge(u, v, std::lround(weight));
+	}
+
+	return Graph(std::move(builder));
+}
+
+template <typename Parser>
+double megabytes_per_second(const std::string& path, Parser&& parse, unsigned& num_edges)
+{
+	double megabytes = std::filesystem::file_size(path) / 1e6;
+
+	WallTimer timer;
+	timer.start();
+	for (unsigned r = 0; r < NUM_REPETITIONS; ++r)
+	{
+		num_edges = parse(path).num_edges();
+	}
+
+	return NUM_REPETITIONS * megabytes / (timer.elapsed_nanoseconds() / 1e9);
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; ++i)
+	{
+		names.emplace_back(argv[i]);
+	}
+
+	if (names.empty())
+	{
+		names = get_state_names();
+	}
+
+	for (const auto& name : names)
+	{
+		std::string path = ROAD_NETWORK_DIRECTORY + name + RAW_NETWORK_EXTENSION;
+
+		unsigned ifstream_edges, parallel_edges;
+		double ifstream_throughput = megabytes_per_second(path, parse_raw_graph_with_ifstream, ifstream_edges);
+		double parallel_throughput = megabytes_per_second(path, parse_raw_graph, parallel_edges);
+
+		printf("%s: %.1f MB, %u edges%s\n", name.c_str(), std::filesystem::file_size(path) / 1e6, parallel_edges, ifstream_edges == parallel_edges ? "" : " (MISMATCH)");
+		printf("\tifstream:        %.1f MB/s\n", ifstream_throughput);
+		printf("\tparallel chunks: %.1f MB/s\n", parallel_throughput);
+		printf("\tspeedup: %.2fx\n", parallel_throughput / ifstream_throughput);
+	}
+
+	return 0;
+}
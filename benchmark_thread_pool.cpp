@@ -0,0 +1,55 @@
+#include "src/data.hpp"
+#include "src/highway.hpp"
+#include "src/road_networks.hpp"
+#include "src/thread_pool.hpp"
+
+#include <cmath>
+#include <string>
+
+#include <stdio.h>
+
+static const unsigned NUM_BATCHES = 20;
+static const unsigned BATCH_SIZE = 1000;
+
+int main(int argc, char* argv[])
+{
+	std::string state = argc > 1 ? argv[1] : "DE";
+	unsigned max_threads = argc > 2 ? std::stoul(argv[2]) : 64;
+
+	WallTimer timer;
+
+	timer.start("Loading contraction hierarchy for " + state);
+
+	auto ch = get_contraction_hierarchy(state);
+
+	timer.print();
+
+	unsigned k = std::lround(std::log2(ch.node_count()));
+	Highway h(state, ch, k, 1, 1.5);
+
+	printf("threads, time per batch, core utilization\n");
+
+	for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+	{
+		ThreadPool::instance().resize(num_threads);
+
+		h.initialize();
+
+		WallTimer wall_timer;
+		CPUTimer cpu_timer;
+		wall_timer.start();
+		cpu_timer.start();
+
+		for (unsigned batch = 0; batch < NUM_BATCHES; ++batch)
+		{
+			h.get_total_greedy_path_length(BATCH_SIZE);
+		}
+
+		double wall_nanoseconds = wall_timer.elapsed_nanoseconds();
+		double cpu_nanoseconds = cpu_timer.elapsed_nanoseconds();
+
+		printf("%u, %s, %.1f%%\n", num_threads, pretty_print(wall_nanoseconds / NUM_BATCHES).c_str(), 100.0 * cpu_nanoseconds / (wall_nanoseconds * num_threads));
+	}
+
+	return 0;
+}
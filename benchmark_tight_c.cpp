@@ -0,0 +1,132 @@
+#include "src/ball_profile.hpp"
+#include "src/data.hpp"
+#include "src/graph.hpp"
+#include "src/road_networks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <stdio.h>
+
+static const unsigned NUM_SOURCES = 20;
+static const unsigned NUM_PROFILE_BALLS = 1'000'000;
+static const unsigned NUM_EVALUATIONS = 100;
+
+// tight_c of the exact minimizer may exceed Brent's only by rounding
+static const double MAX_RELATIVE_EXCESS = 1e-9;
+
+// time per tight_c evaluation over a synthetic profile of NUM_PROFILE_BALLS balls, growing roughly like distance^1.5
+void benchmark_tight_c_evaluation(std::mt19937& rng)
+{
+	std::uniform_real_distribution<double> jitter(0.9, 1.1);
+
+	std::vector<Ball> balls;
+	for (unsigned count = 1; count <= NUM_PROFILE_BALLS; ++count)
+	{
+		unsigned distance = std::max(balls.empty() ? 1u : balls.back().distance, unsigned(std::pow(count, 1 / 1.5) * jitter(rng)));
+		balls.push_back({ distance, count });
+	}
+
+	WallTimer timer;
+	double checksum = 0.0;
+
+	timer.start();
+	for (unsigned i = 0; i < NUM_EVALUATIONS; ++i)
+	{
+		checksum += Graph::tight_c(balls, 1.0 + i * 1e-3);
+	}
+	double pow_nanoseconds = double(timer.elapsed_nanoseconds()) / NUM_EVALUATIONS;
+
+	timer.start();
+	BallProfile profile(balls);
+	double profile_build_nanoseconds = timer.elapsed_nanoseconds();
+
+	double max_relative_difference = 0.0;
+
+	timer.start();
+	for (unsigned i = 0; i < NUM_EVALUATIONS; ++i)
+	{
+		checksum -= profile.tight_c(1.0 + i * 1e-3);
+	}
+	double profile_nanoseconds = double(timer.elapsed_nanoseconds()) / NUM_EVALUATIONS;
+
+	for (double alpha : { 0.5, 1.5, 2.5 })
+	{
+		double expected = Graph::tight_c(balls, alpha);
+		max_relative_difference = std::max(max_relative_difference, std::abs(profile.tight_c(alpha) - expected) / expected);
+	}
+
+	printf("tight_c over %u balls (checksum %.3e, max relative difference %.2e)\n", NUM_PROFILE_BALLS, checksum, max_relative_difference);
+	printf("\tstd::pow per ball:   %s per evaluation\n", pretty_print(pow_nanoseconds).c_str());
+	printf("\tlog-space profile:   %s per evaluation (built once in %s)\n", pretty_print(profile_nanoseconds).c_str(), pretty_print(profile_build_nanoseconds).c_str());
+	printf("\tspeedup: %.2fx\n", pow_nanoseconds / profile_nanoseconds);
+}
+
+// Times tight_c evaluations, then checks that the exact convex hull minimizer of tight_c agrees with Brent
+// on the bundled networks and compares their running times
+int main(int argc, char* argv[])
+{
+	unsigned num_to_skip = argc > 1 ? std::stoul(argv[1]) : 0;
+	unsigned min_distance = argc > 2 ? std::stoul(argv[2]) : 0;
+
+	WallTimer timer;
+	std::mt19937 rng(12345);
+	bool all_agree = true;
+
+	benchmark_tight_c_evaluation(rng);
+
+	for (const auto& name : get_state_names())
+	{
+		auto graph = get_graph(name);
+		std::uniform_int_distribution<unsigned> pick(0, graph.size() - 1);
+
+		double brent_nanoseconds = 0.0;
+		double exact_nanoseconds = 0.0;
+		double max_difference = 0.0;
+		unsigned num_brent_failures = 0;
+		unsigned num_disagreements = 0;
+
+		for (unsigned i = 0; i < NUM_SOURCES; ++i)
+		{
+			auto balls = graph.get_balls(pick(rng));
+
+			timer.start();
+			double brent = Graph::minimize_tight_c(balls, 1.5, num_to_skip, min_distance);
+			brent_nanoseconds += timer.elapsed_nanoseconds();
+
+			timer.start();
+			double exact = Graph::minimize_tight_c_exactly(balls, num_to_skip, min_distance);
+			exact_nanoseconds += timer.elapsed_nanoseconds();
+
+			// Brent gives up when the minimum looks like it is at a boundary; the exact minimizer does not need to
+			if (brent < 0.0)
+			{
+				++num_brent_failures;
+				continue;
+			}
+
+			// both must reach the same minimum; the minimizers themselves may differ where tight_c is flat
+			double brent_c = Graph::tight_c(balls, brent, num_to_skip, min_distance);
+			double exact_c = Graph::tight_c(balls, exact, num_to_skip, min_distance);
+
+			if (exact_c > brent_c * (1 + MAX_RELATIVE_EXCESS))
+			{
+				++num_disagreements;
+			}
+
+			max_difference = std::max(max_difference, std::abs(brent - exact));
+		}
+
+		all_agree = all_agree && num_disagreements == 0;
+
+		printf("%s: %u sources, %u Brent failures, %u disagreements, max |alpha difference| %.2e\n", name.c_str(), NUM_SOURCES, num_brent_failures, num_disagreements, max_difference);
+		printf("\tBrent:       %s per source\n", pretty_print(brent_nanoseconds / NUM_SOURCES).c_str());
+		printf("\tconvex hull: %s per source\n", pretty_print(exact_nanoseconds / NUM_SOURCES).c_str());
+	}
+
+	printf("%s\n", all_agree ? "PASSED" : "FAILED");
+
+	return all_agree ? 0 : 1;
+}
@@ -1,9 +1,10 @@
 #include "src/data.hpp"
 #include "src/highway.hpp"
-#include "src/lattice.hpp"
+#include "src/implicit_lattice.hpp"
 #include "src/road_networks.hpp"
 
 #include <cmath>
+#include <cstdint>
 
 void find_for_names(const std::vector<std::string>& names, unsigned offset, unsigned total, unsigned Q = 1)
 {
@@ -33,11 +34,18 @@ void find_for_names(const std::vector<std::string>& names, unsigned offset, unsi
 			continue;
 		}
 
-		Highway h(state, ch, k, Q, 1.5);
+		// trials stay within the largest (strongly) connected component, where every node reaches every other
+		auto graph = get_graph(state);
+
+		HighwayOptions options;
+		options.components = graph.components();
+
+		Highway h(state, ch, k, Q, 1.5, options);
 
 		timer.start("Determining optimal clustering exponent for " + state);
 
-		double clustering_exponent = h.estimate_optimal_clustering_exponent();
+		// every round routes a whole grid of exponents over the same highway and trials
+		double clustering_exponent = h.estimate_optimal_clustering_exponent_from_curve();
 
 		timer.print();
 
@@ -47,17 +55,19 @@ void find_for_names(const std::vector<std::string>& names, unsigned offset, unsi
 	}
 }
 
-void find_for_lattices(unsigned dimension, bool wrap_around = true, unsigned Q = 1)
+template <unsigned DIMENSION>
+void find_for_lattices(bool wrap_around = true, unsigned Q = 1)
 {
 	WallTimer timer;
 
-	for (unsigned side_length = 16; ; side_length *= 8)
+	// lattices grow until their nodes would no longer fit LatticeOracle's 32-bit node ids
+	for (uint64_t side_length = 16; LatticeOracle<DIMENSION>::fits(side_length); side_length *= 8)
 	{
-		std::string name = std::to_string(dimension) + "D_" + std::to_string(side_length);
+		std::string name = std::to_string(DIMENSION) + "D_" + std::to_string(side_length);
 		name += wrap_around ? "-wrap" : "";
 
-		unsigned num_nodes = std::pow(side_length, dimension);
-		unsigned k = std::lround(std::log2(num_nodes));
+		ImplicitLattice<DIMENSION> lattice(side_length, wrap_around);
+		unsigned k = std::lround(std::log2(lattice.size()));
 
 		if (has_optimal_clustering_exponent_data(k, Q).contains(name))
 		{
@@ -65,17 +75,11 @@ void find_for_lattices(unsigned dimension, bool wrap_around = true, unsigned Q =
 			continue;
 		}
 
-		timer.start("Generating lattice for " + name);
-
-		Lattice lattice(side_length, dimension, wrap_around);
-
-		timer.print();
-
 		timer.start("Determining optimal dimension for " + name);
 
 		// because of wrap-around, every node is identical, so we can get the dimension estimate by looking at the balls of any arbitrary node
 		auto balls = lattice.get_balls(0);
-		double estimated_dimension = Graph::minimize_tight_c(balls, dimension);
+		double estimated_dimension = Graph::minimize_tight_c(balls, DIMENSION);
 
 		timer.print();
 
@@ -85,13 +89,8 @@ void find_for_lattices(unsigned dimension, bool wrap_around = true, unsigned Q =
 
 		save_dimension_data(name, 0, 0, estimated_dimension);
 
-		timer.start("Loading contraction hierarchy for " + name);
-
-		auto ch = lattice.get_contraction_hierarchy();
-
-		timer.print();
-
-		Highway h(name, ch, k, Q, estimated_dimension);
+		// lattice distances are arithmetic, so no contraction hierarchy is built
+		Highway h(name, LatticeOracle(lattice), k, Q, estimated_dimension);
 
 		timer.start("Determining optimal clustering exponent for " + name);
 
@@ -115,7 +114,7 @@ int main(int argc, char* argv[])
 	find_for_names(get_state_names(), offset, total);
 	find_for_names(get_non_state_names(), offset, total);
 
-	// find_for_lattices(3);
+	// find_for_lattices<3>();
 
 	return 0;
 }
\ No newline at end of file
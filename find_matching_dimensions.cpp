@@ -2,6 +2,7 @@
 
 #include "src/data.hpp"
 #include "src/highway.hpp"
+#include "src/phast.hpp"
 #include "src/road_networks.hpp"
 
 int main(int argc, char* argv[] )
@@ -30,13 +31,16 @@ int main(int argc, char* argv[] )
 
 		timer.start("Loading graph for " + state);
 
-		auto g = get_graph(state);
+		// PHAST sweeps only the core; balls are still counted in the nodes of the graph
+		auto compression = get_chain_compression(state);
+		auto ch = get_core_contraction_hierarchy(state, compression);
+		PHAST phast(ch);
 
 		timer.print();
 
 		timer.start("Determining optimal dimension for " + state);
 
-		double dimension = g.estimate_optimal_dimension(1.5, num_to_skip, min_distance);
+		double dimension = compression.estimate_optimal_dimension(1.5, num_to_skip, min_distance, 2e-3, &phast);
 
 		timer.print();
 
@@ -0,0 +1,122 @@
+#include "src/data.hpp"
+#include "src/road_networks.hpp"
+#include "src/thread_pool.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <unistd.h>
+
+// a conservative estimate of RoutingKit's peak memory while contracting, per edge of the input graph
+static const size_t CONTRACTION_MEMORY_PER_EDGE = 512;
+
+struct Job
+{
+	std::string name;
+	size_t memory;
+
+	// the hierarchy of the network's chain-compressed core rather than of the whole network
+	bool core;
+};
+
+// Builds every missing or stale contraction hierarchy, of every network and of its chain-compressed core, so that
+// the drivers never have to. Networks are contracted concurrently, largest first, as long as their estimated memory
+// fits in the budget; one that exceeds the whole budget is contracted alone.
+int main(int argc, char* argv[])
+{
+	size_t memory_budget = argc > 1 ? size_t(std::stod(argv[1]) * (size_t(1) << 30)) : size_t(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE) / 2;
+
+	std::vector<std::string> names = get_state_names();
+	for (const auto& name : get_non_state_names())
+	{
+		names.push_back(name);
+	}
+
+	std::vector<Job> jobs;
+
+	for (const auto& name : names)
+	{
+		auto graph = get_graph(name);
+
+		if (!has_current_contraction_hierarchy(name))
+		{
+			jobs.push_back({ name, size_t(graph.num_edges()) * CONTRACTION_MEMORY_PER_EDGE, false });
+		}
+
+		// a network without chains is its own core
+		ChainCompression compression(graph);
+		if (compression.num_core_nodes() < compression.size() && !has_current_core_contraction_hierarchy(name))
+		{
+			jobs.push_back({ name, size_t(compression.core().num_edges()) * CONTRACTION_MEMORY_PER_EDGE, true });
+		}
+	}
+
+	std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.memory > b.memory; });
+
+	printf("%zu contraction hierarchies to build, memory budget %.1f GiB\n", jobs.size(), double(memory_budget) / (size_t(1) << 30));
+
+	std::mutex mutex;
+	std::condition_variable memory_released;
+	size_t next_job = 0;
+	size_t memory_in_use = 0;
+
+	auto contract = [&]()
+	{
+		while (true)
+		{
+			std::unique_lock lock(mutex);
+
+			if (next_job == jobs.size())
+			{
+				return;
+			}
+
+			const Job& job = jobs[next_job++];
+			memory_released.wait(lock, [&]() { return memory_in_use == 0 || memory_in_use + job.memory <= memory_budget; });
+			memory_in_use += job.memory;
+
+			const char* what = job.core ? " core" : "";
+			printf("Contracting %s%s (~%.2f GiB)\n", job.name.c_str(), what, double(job.memory) / (size_t(1) << 30));
+			fflush(stdout);
+
+			lock.unlock();
+
+			WallTimer timer;
+			timer.start();
+
+			if (job.core)
+			{
+				get_core_contraction_hierarchy(job.name, get_chain_compression(job.name));
+			}
+			else
+			{
+				get_contraction_hierarchy(job.name);
+			}
+
+			lock.lock();
+			memory_in_use -= job.memory;
+			printf("Contracted %s%s in %s\n", job.name.c_str(), what, pretty_print(timer.elapsed_nanoseconds()).c_str());
+			fflush(stdout);
+
+			memory_released.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < std::min<size_t>(NUM_THREADS, jobs.size()); ++i)
+	{
+		threads.emplace_back(contract);
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	return 0;
+}
@@ -84,7 +84,13 @@ int main(int argc, char* argv[])
 
 		unsigned k = std::lround(std::log2(ch.node_count()));
 
-		Highway h2(state, ch, k, 1, 2);
+		// trials stay within the largest (strongly) connected component, where every node reaches every other
+		auto graph = get_graph(state);
+
+		HighwayOptions options;
+		options.components = graph.components();
+
+		Highway h2(state, ch, k, 1, 2, options);
 
 		timer.start("Determining greedy path length when alpha = 2");
 
@@ -95,7 +101,7 @@ int main(int argc, char* argv[])
 		printf("Greedy path length for %s when alpha = 2: %f\n", state.c_str(), path_length_2);
 
 		// now when alpha = dimension
-		Highway h_dimension(state, ch, k, 1, dimension);
+		Highway h_dimension(state, ch, k, 1, dimension, options);
 
 		timer.start("Determining greedy path length when alpha = " + std::to_string(dimension));
 
@@ -0,0 +1,130 @@
+#include "alias_sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace
+{
+	// This file is compiled with -ffast-math, which assumes no infinities or NaNs. Distances are clamped to
+	// [1, 2^32), so their logarithms lie in [0, 22.2], and with a non-negative exponent every weight lies in
+	// [exp(MIN_LOG_WEIGHT), 1]: finite, non-zero and normal, so the totals in build() stay finite and positive too.
+	const double MIN_LOG_WEIGHT = -700.0;
+
+	// exponent >= 0
+	double power_law_weight(double log_distance, double exponent) noexcept
+	{
+		return std::exp(std::max(-exponent * log_distance, MIN_LOG_WEIGHT));
+	}
+}
+
+void AliasSampler::build(std::span<const double> weights) noexcept
+{
+	unsigned n = weights.size();
+
+	_probability.resize(n);
+	_alias.resize(n);
+	_small.clear();
+	_large.clear();
+
+	double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+	for (unsigned i = 0; i < n; ++i)
+	{
+		// an all-zero weight vector degenerates to the uniform distribution
+		_probability[i] = total > 0.0 ? weights[i] * n / total : 1.0;
+		_alias[i] = i;
+
+		if (_probability[i] < 1.0)
+		{
+			_small.push_back(i);
+		}
+		else
+		{
+			_large.push_back(i);
+		}
+	}
+
+	while (!_small.empty() && !_large.empty())
+	{
+		unsigned small = _small.back();
+		unsigned large = _large.back();
+		_small.pop_back();
+
+		_alias[small] = large;
+		_probability[large] -= 1.0 - _probability[small];
+
+		if (_probability[large] < 1.0)
+		{
+			_large.pop_back();
+			_small.push_back(large);
+		}
+	}
+
+	// whatever is left over is only off from 1.0 by rounding error
+	for (unsigned i : _small)
+	{
+		_probability[i] = 1.0;
+	}
+
+	for (unsigned i : _large)
+	{
+		_probability[i] = 1.0;
+	}
+}
+
+unsigned AliasSampler::size() const noexcept
+{
+	return _probability.size();
+}
+
+void compute_power_law_weights(std::span<const unsigned> distances, double exponent, std::vector<double>& weights) noexcept
+{
+	unsigned n = distances.size();
+	weights.resize(n);
+
+	const unsigned* d = distances.data();
+	double* w = weights.data();
+	exponent = std::max(exponent, 0.0);
+
+	#pragma omp simd
+	for (unsigned i = 0; i < n; ++i)
+	{
+		double distance = std::max(d[i], 1u);
+		w[i] = power_law_weight(std::log(distance), exponent);
+	}
+}
+
+void compute_log_distances(std::span<const unsigned> distances, std::vector<double>& log_distances) noexcept
+{
+	unsigned n = distances.size();
+	log_distances.resize(n);
+
+	const unsigned* d = distances.data();
+	double* l = log_distances.data();
+
+	#pragma omp simd
+	for (unsigned i = 0; i < n; ++i)
+	{
+		double distance = std::max(d[i], 1u);
+		l[i] = std::log(distance);
+	}
+}
+
+void compute_power_law_weights(std::span<const double> log_distances, double exponent, std::vector<double>& weights) noexcept
+{
+	unsigned n = log_distances.size();
+	weights.resize(n);
+
+	const double* l = log_distances.data();
+	double* w = weights.data();
+	exponent = std::max(exponent, 0.0);
+
+	#pragma omp simd
+	for (unsigned i = 0; i < n; ++i)
+	{
+		w[i] = power_law_weight(l[i], exponent);
+	}
+}
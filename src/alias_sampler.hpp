@@ -0,0 +1,41 @@
+#pragma once
+
+#include <random>
+#include <span>
+#include <vector>
+
+// Walker/Vose alias table: O(n) to build, O(1) per draw.
+// The buffers are kept between builds, so a thread_local sampler allocates only when it grows.
+class AliasSampler
+{
+public:
+	void build(std::span<const double> weights) noexcept;
+
+	template <typename RNG>
+	unsigned operator()(RNG& rng) const noexcept
+	{
+		double x = std::uniform_real_distribution<double>(0.0, _probability.size())(rng);
+		unsigned i = std::min(static_cast<unsigned>(x), size() - 1);
+
+		return x - i < _probability[i] ? i : _alias[i];
+	}
+
+	unsigned size() const noexcept;
+
+private:
+	std::vector<double> _probability;
+	std::vector<unsigned> _alias;
+
+	std::vector<unsigned> _small;
+	std::vector<unsigned> _large;
+};
+
+// weights[i] = distances[i]^-exponent, evaluated as exp(-exponent * log(distance)) so the loop vectorizes.
+// Distances of 0 are treated as 1, so that every weight stays finite: they get weight 1, where pow(0, -exponent) is
+// infinite and std::discrete_distribution could not sample at all. The exponent must be finite; negative ones are
+// treated as 0, and no weight drops below exp(-700), so none is 0 or denormal.
+void compute_power_law_weights(std::span<const unsigned> distances, double exponent, std::vector<double>& weights) noexcept;
+
+// The same weights split in two, so that one row of logarithms can be shared by several exponents
+void compute_log_distances(std::span<const unsigned> distances, std::vector<double>& log_distances) noexcept;
+void compute_power_law_weights(std::span<const double> log_distances, double exponent, std::vector<double>& weights) noexcept;
@@ -0,0 +1,59 @@
+#include "ball_profile.hpp"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+BallProfile::BallProfile(const std::vector<Ball>& balls, unsigned num_to_skip, unsigned min_distance)
+{
+	_log_counts.reserve(balls.size());
+	_log_distances.reserve(balls.size());
+
+	for (const auto& ball : balls)
+	{
+		if (ball.count <= num_to_skip || ball.distance < min_distance)
+		{
+			continue;
+		}
+
+		if (ball.distance == 0)
+		{
+			_has_zero_distance = true;
+			continue;
+		}
+
+		_log_counts.push_back(std::log(ball.count));
+		_log_distances.push_back(std::log(ball.distance));
+	}
+}
+
+unsigned BallProfile::size() const noexcept
+{
+	return _log_counts.size();
+}
+
+double BallProfile::tight_c(double alpha) const noexcept
+{
+	if (_has_zero_distance && alpha > 0.0)
+	{
+		return std::numeric_limits<double>::infinity();
+	}
+
+	const double* log_counts = _log_counts.data();
+	const double* log_distances = _log_distances.data();
+	size_t n = _log_counts.size();
+
+	double min = std::numeric_limits<double>::infinity();
+	double max = -std::numeric_limits<double>::infinity();
+
+	// -fopenmp-simd turns this into AVX2 or AVX-512 FMAs and min/max as -march allows, and scalar code otherwise
+	#pragma omp simd reduction(min:min) reduction(max:max)
+	for (size_t i = 0; i < n; ++i)
+	{
+		double value = std::fma(-alpha, log_distances[i], log_counts[i]);
+		min = value < min ? value : min;
+		max = value > max ? value : max;
+	}
+
+	return std::exp(max - min);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "cache_aligned_allocator.hpp"
+#include "graph.hpp"
+
+#include <vector>
+
+// The balls that Graph::tight_c looks at, filtered once and kept as log(count) and log(distance), so that
+// tight_c(alpha) is exp(max - min) of log(count) - alpha * log(distance): one vectorized FMA with a min/max reduction.
+class BallProfile
+{
+public:
+	BallProfile(const std::vector<Ball>& balls, unsigned num_to_skip = 0, unsigned min_distance = 0);
+
+	unsigned size() const noexcept;
+
+	// equal to Graph::tight_c(balls, alpha, num_to_skip, min_distance) up to rounding
+	double tight_c(double alpha) const noexcept;
+
+private:
+	std::vector<double, CacheAlignedAllocator<double>> _log_counts;
+	std::vector<double, CacheAlignedAllocator<double>> _log_distances;
+
+	// a ball at distance 0 makes tight_c infinite for every positive alpha, as pow(0, alpha) does
+	bool _has_zero_distance = false;
+};
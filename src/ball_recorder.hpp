@@ -0,0 +1,58 @@
+#pragma once
+
+#include "graph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Records the balls of one growth as it settles nodes in order of distance, as BallGrowth asks
+class BallRecorder
+{
+public:
+	BallRecorder(const BallGrowth& growth, std::vector<Ball>& balls) noexcept :
+		_growth(growth), _balls(balls)
+	{
+		_balls.clear();
+	}
+
+	// false once the growth should stop
+	bool settle(unsigned distance)
+	{
+		if (distance > _growth.max_distance)
+		{
+			return false;
+		}
+
+		_last = { distance, _last.count + 1 };
+
+		if (is_wanted(_last) && _last.count >= _next_count)
+		{
+			_balls.push_back(_last);
+			_next_count = std::max<double>(_last.count + 1, std::ceil(_last.count * _growth.growth_factor));
+		}
+
+		return _last.count < _growth.max_count;
+	}
+
+	// the last ball is always recorded, so sampling never cuts off the largest scale
+	void finish()
+	{
+		if (is_wanted(_last) && (_balls.empty() || _balls.back().count != _last.count))
+		{
+			_balls.push_back(_last);
+		}
+	}
+
+private:
+	bool is_wanted(const Ball& ball) const noexcept
+	{
+		return ball.count > _growth.num_to_skip && ball.distance >= _growth.min_distance;
+	}
+
+	const BallGrowth& _growth;
+	std::vector<Ball>& _balls;
+
+	Ball _last = { 0, 0 };
+	double _next_count = 0.0;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Allocates on cache-line boundaries, so vector loads and 64-byte rows never straddle lines
+template <typename T>
+struct CacheAlignedAllocator
+{
+	using value_type = T;
+
+	static constexpr std::align_val_t ALIGNMENT{ 64 };
+
+	CacheAlignedAllocator() = default;
+
+	template <typename U>
+	CacheAlignedAllocator(const CacheAlignedAllocator<U>&) noexcept
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T), ALIGNMENT));
+	}
+
+	void deallocate(T* p, size_t) noexcept
+	{
+		::operator delete(p, ALIGNMENT);
+	}
+
+	bool operator==(const CacheAlignedAllocator&) const noexcept = default;
+};
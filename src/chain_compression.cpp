@@ -0,0 +1,651 @@
+#include "chain_compression.hpp"
+
+#include "ball_recorder.hpp"
+#include "highway_distance_matrix.hpp"
+#include "radix_heap.hpp"
+#include "thread_pool.hpp"
+
+#include <routingkit/constants.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// What a ball search knows about one chain, valid if its epoch is the current one: the slots [begin, end) its
+	// walks have not settled yet, and the distance each walk adds its offsets to. Walk 2 * c moves up chain c from its
+	// tail, 2 * c + 1 down from its head. Kept together, since a walk touches all of it with every node it settles.
+	struct ChainWalks
+	{
+		unsigned begin;
+		unsigned end;
+		unsigned epoch;
+		std::array<unsigned, 2> base;
+	};
+
+	// Workspace for ChainCompression::get_balls. Core nodes get tentative distances, valid if their epoch is the
+	// current one, as in Graph::get_balls.
+	struct ChainBallSearch
+	{
+		std::vector<unsigned> distance;
+		std::vector<unsigned> epoch;
+		std::vector<ChainWalks> chains;
+
+		unsigned current_epoch = 0;
+		RadixHeap<unsigned> queue;
+
+		void reset(unsigned num_core_nodes, unsigned num_chains)
+		{
+			if (epoch.size() != num_core_nodes || chains.size() != num_chains || ++current_epoch == 0)
+			{
+				distance.assign(num_core_nodes, 0);
+				epoch.assign(num_core_nodes, 0);
+				chains.assign(num_chains, {});
+				current_epoch = 1;
+			}
+
+			queue.clear();
+		}
+	};
+
+	// d + offset, or inf_weight if d is
+	unsigned add_distance(unsigned d, unsigned offset) noexcept
+	{
+		return d == RoutingKit::inf_weight ? RoutingKit::inf_weight : d + offset;
+	}
+}
+
+ChainCompression::ChainCompression(const Graph& graph) :
+	_core(GraphBuilder(0))
+{
+	unsigned num_nodes = graph.size();
+
+	// a node only continues a road if it has exactly two neighbors, neither of them itself
+	std::vector<bool> is_interior(num_nodes, false);
+
+	if (!graph.is_directed())
+	{
+		for (unsigned u = 0; u < num_nodes; ++u)
+		{
+			auto neighbors = graph.get_neighbors(u).targets();
+			is_interior[u] = neighbors.size() == 2 && neighbors[0] != u && neighbors[1] != u;
+		}
+	}
+
+	_slot.assign(num_nodes, RoutingKit::invalid_id);
+	_chain_first.assign(1, 0);
+
+	std::vector<unsigned> chain_tail;
+	std::vector<unsigned> chain_head;
+
+	// follows the chain from tail through its first interior node to the next node that is not interior
+	auto walk = [&](unsigned tail, unsigned first, unsigned weight)
+	{
+		unsigned chain = chain_tail.size();
+		unsigned previous = tail;
+		unsigned current = first;
+		unsigned offset = weight;
+
+		while (is_interior[current])
+		{
+			_slot[current] = _chain_node.size();
+			_chain_node.push_back(current);
+			_offset.push_back(offset);
+			_slot_chain.push_back(chain);
+
+			auto neighbors = graph.get_neighbors(current);
+			unsigned next = neighbors.targets()[0] == previous ? 1 : 0;
+
+			previous = current;
+			current = neighbors.targets()[next];
+			offset += neighbors.weights()[next];
+		}
+
+		chain_tail.push_back(tail);
+		chain_head.push_back(current);
+		_chain_length.push_back(offset);
+		_chain_first.push_back(_chain_node.size());
+	};
+
+	// every chain is found from both of its ends, and followed from the first
+	for (unsigned u = 0; u < num_nodes; ++u)
+	{
+		if (is_interior[u])
+		{
+			continue;
+		}
+
+		for (const auto& [neighbor, weight] : graph.get_neighbors(u))
+		{
+			if (is_interior[neighbor] && _slot[neighbor] == RoutingKit::invalid_id)
+			{
+				walk(u, neighbor, weight);
+			}
+		}
+	}
+
+	// what is left are cycles of interior nodes, each of which becomes a loop at its first node
+	for (unsigned u = 0; u < num_nodes; ++u)
+	{
+		if (is_interior[u] && _slot[u] == RoutingKit::invalid_id)
+		{
+			is_interior[u] = false;
+
+			auto neighbors = graph.get_neighbors(u);
+			walk(u, neighbors.targets()[0], neighbors.weights()[0]);
+		}
+	}
+
+	_core_node.assign(num_nodes, RoutingKit::invalid_id);
+
+	for (unsigned u = 0; u < num_nodes; ++u)
+	{
+		if (!is_interior[u])
+		{
+			_core_node[u] = _original_node.size();
+			_original_node.push_back(u);
+		}
+	}
+
+	unsigned num_core_nodes = _original_node.size();
+	unsigned num_chains = chain_tail.size();
+
+	_chain_tail.resize(num_chains);
+	_chain_head.resize(num_chains);
+	_first_chain_end.assign(num_core_nodes + 1, 0);
+
+	for (unsigned chain = 0; chain < num_chains; ++chain)
+	{
+		_chain_tail[chain] = _core_node[chain_tail[chain]];
+		_chain_head[chain] = _core_node[chain_head[chain]];
+
+		++_first_chain_end[_chain_tail[chain] + 1];
+		++_first_chain_end[_chain_head[chain] + 1];
+	}
+
+	for (unsigned u = 0; u < num_core_nodes; ++u)
+	{
+		_first_chain_end[u + 1] += _first_chain_end[u];
+	}
+
+	_chain_end.resize(_first_chain_end[num_core_nodes]);
+	std::vector<unsigned> next_chain_end(_first_chain_end.begin(), _first_chain_end.end() - 1);
+
+	for (unsigned chain = 0; chain < num_chains; ++chain)
+	{
+		_chain_end[next_chain_end[_chain_tail[chain]]++] = 2 * chain;
+		_chain_end[next_chain_end[_chain_head[chain]]++] = 2 * chain + 1;
+	}
+
+	// the core keeps the edges between core nodes, each added once, and gets one edge per chain between distinct ends
+	GraphBuilder builder(num_core_nodes, graph.is_directed());
+
+	for (unsigned u = 0; u < num_nodes; ++u)
+	{
+		if (is_interior[u])
+		{
+			continue;
+		}
+
+		for (const auto& [neighbor, weight] : graph.get_neighbors(u))
+		{
+			if (!is_interior[neighbor] && (graph.is_directed() || u <= neighbor))
+			{
+				builder.add_edge(_core_node[u], _core_node[neighbor], weight);
+			}
+		}
+	}
+
+	for (unsigned chain = 0; chain < num_chains; ++chain)
+	{
+		if (_chain_tail[chain] != _chain_head[chain])
+		{
+			builder.add_edge(_chain_tail[chain], _chain_head[chain], _chain_length[chain]);
+		}
+	}
+
+	_core = Graph(std::move(builder));
+}
+
+const Graph& ChainCompression::core() const noexcept
+{
+	return _core;
+}
+
+unsigned ChainCompression::size() const noexcept
+{
+	return _core_node.size();
+}
+
+unsigned ChainCompression::num_core_nodes() const noexcept
+{
+	return _original_node.size();
+}
+
+unsigned ChainCompression::num_chains() const noexcept
+{
+	return _chain_length.size();
+}
+
+bool ChainCompression::is_core_node(unsigned u) const noexcept
+{
+	return _core_node[u] != RoutingKit::invalid_id;
+}
+
+unsigned ChainCompression::core_node(unsigned u) const noexcept
+{
+	return _core_node[u];
+}
+
+unsigned ChainCompression::original_node(unsigned core_node) const noexcept
+{
+	return _original_node[core_node];
+}
+
+unsigned ChainCompression::core_ends(unsigned u, std::array<CoreEnd, 2>& ends) const noexcept
+{
+	if (is_core_node(u))
+	{
+		ends[0] = { _core_node[u], 0 };
+		return 1;
+	}
+
+	unsigned chain = _slot_chain[_slot[u]];
+
+	ends[0] = { _chain_tail[chain], distance_to_tail(u) };
+	ends[1] = { _chain_head[chain], distance_to_head(u) };
+	return 2;
+}
+
+unsigned ChainCompression::distance_along_chain(unsigned s, unsigned t) const noexcept
+{
+	if (is_core_node(s) || is_core_node(t) || _slot_chain[_slot[s]] != _slot_chain[_slot[t]])
+	{
+		return RoutingKit::inf_weight;
+	}
+
+	unsigned s_offset = _offset[_slot[s]];
+	unsigned t_offset = _offset[_slot[t]];
+
+	return s_offset < t_offset ? t_offset - s_offset : s_offset - t_offset;
+}
+
+unsigned ChainCompression::step_along_chain(unsigned u, unsigned t) const noexcept
+{
+	unsigned slot = _slot[u];
+	unsigned chain = _slot_chain[slot];
+
+	if (_slot[t] < slot)
+	{
+		return slot == _chain_first[chain] ? _original_node[_chain_tail[chain]] : _chain_node[slot - 1];
+	}
+
+	return slot + 1 == _chain_first[chain + 1] ? _original_node[_chain_head[chain]] : _chain_node[slot + 1];
+}
+
+unsigned ChainCompression::step_towards_end(unsigned u, unsigned end) const noexcept
+{
+	unsigned slot = _slot[u];
+	unsigned chain = _slot_chain[slot];
+
+	bool towards_tail = _chain_tail[chain] == _chain_head[chain] ? distance_to_tail(u) <= distance_to_head(u) : end == _chain_tail[chain];
+
+	if (towards_tail)
+	{
+		return slot == _chain_first[chain] ? _original_node[_chain_tail[chain]] : _chain_node[slot - 1];
+	}
+
+	return slot + 1 == _chain_first[chain + 1] ? _original_node[_chain_head[chain]] : _chain_node[slot + 1];
+}
+
+unsigned ChainCompression::step_into_chain(unsigned end, unsigned t) const noexcept
+{
+	unsigned chain = _slot_chain[_slot[t]];
+
+	bool from_tail = _chain_tail[chain] == _chain_head[chain] ? distance_to_tail(t) <= distance_to_head(t) : end == _chain_tail[chain];
+
+	return _chain_node[first_slot(chain, from_tail)];
+}
+
+unsigned ChainCompression::step_towards_core_node(unsigned u, unsigned v) const noexcept
+{
+	// the weight of the core edge is that of the lightest edge or chain between u and v
+	auto neighbors = _core.get_neighbors(u);
+	auto targets = neighbors.targets();
+	unsigned edge_weight = neighbors.weights()[std::lower_bound(targets.begin(), targets.end(), v) - targets.begin()];
+
+	for (unsigned i = _first_chain_end[u]; i < _first_chain_end[u + 1]; ++i)
+	{
+		unsigned chain = _chain_end[i] / 2;
+		bool from_tail = _chain_end[i] % 2 == 0;
+		unsigned other_end = from_tail ? _chain_head[chain] : _chain_tail[chain];
+
+		if (other_end == v && _chain_length[chain] == edge_weight)
+		{
+			return _chain_node[first_slot(chain, from_tail)];
+		}
+	}
+
+	return _original_node[v];
+}
+
+void ChainCompression::get_balls(unsigned u, std::vector<Ball>& balls, const BallGrowth& growth) const
+{
+	// an interior source splits its chain: the part towards the head becomes an extra chain, numbered num_chains()
+	unsigned num_core_nodes = this->num_core_nodes();
+	unsigned split_chain = num_chains();
+
+	thread_local ChainBallSearch search;
+	search.reset(num_core_nodes, split_chain + 1);
+
+	auto& [distance, epoch, chains, current_epoch, queue] = search;
+
+	BallRecorder recorder(growth, balls);
+
+	// core nodes are queued by core number, walks after them
+	auto relax = [&](unsigned node, unsigned new_distance)
+	{
+		if (epoch[node] != current_epoch || new_distance < distance[node])
+		{
+			epoch[node] = current_epoch;
+			distance[node] = new_distance;
+			queue.push(new_distance, node);
+		}
+	};
+
+	// the distance of the next interior node of the walk
+	auto walk_key = [&](unsigned walk)
+	{
+		const auto& chain = chains[walk / 2];
+		return walk % 2 == 0 ? chain.base[0] + _offset[chain.begin] : chain.base[1] - _offset[chain.end - 1];
+	};
+
+	// queues the next interior node of the walk, unless its chain is settled
+	auto push_walk = [&](unsigned walk)
+	{
+		const auto& chain = chains[walk / 2];
+
+		if (chain.begin < chain.end)
+		{
+			queue.push(walk_key(walk), num_core_nodes + walk);
+		}
+	};
+
+	// the core number of a core source
+	unsigned source = RoutingKit::invalid_id;
+	unsigned source_chain = RoutingKit::invalid_id;
+
+	if (is_core_node(u))
+	{
+		source = _core_node[u];
+		relax(source, 0);
+	}
+	else
+	{
+		unsigned slot = _slot[u];
+		source_chain = _slot_chain[slot];
+
+		// the source walks out both ways; offsets wrap around below it, which unsigned arithmetic undoes
+		chains[source_chain] = { _chain_first[source_chain], slot, current_epoch, { 0, _offset[slot] } };
+		chains[split_chain] = { slot + 1, _chain_first[source_chain + 1], current_epoch, { 0u - _offset[slot], 0 } };
+		push_walk(2 * source_chain + 1);
+		push_walk(2 * split_chain);
+
+		relax(_chain_tail[source_chain], distance_to_tail(u));
+		relax(_chain_head[source_chain], distance_to_head(u));
+	}
+
+	bool is_finished = false;
+
+	while (!queue.empty() && !is_finished)
+	{
+		auto [key, value] = queue.pop();
+
+		if (value >= num_core_nodes)
+		{
+			// a walk's next node is settled unless the walk from the other end got there first; the walk then goes on
+			// without the queue for as long as its next node is no farther than anything queued
+			unsigned walk = value - num_core_nodes;
+			auto& chain = chains[walk / 2];
+
+			while (chain.begin < chain.end)
+			{
+				if (!recorder.settle(key))
+				{
+					is_finished = true;
+					break;
+				}
+
+				if (walk % 2 == 0)
+				{
+					++chain.begin;
+				}
+				else
+				{
+					--chain.end;
+				}
+
+				if (chain.begin >= chain.end)
+				{
+					break;
+				}
+
+				key = walk_key(walk);
+
+				if (!queue.empty() && key > queue.min_key())
+				{
+					queue.push(key, value);
+					break;
+				}
+			}
+
+			continue;
+		}
+
+		unsigned node = value;
+
+		// only the entry of a node's final distance is current; every node is pushed at most once per distance
+		if (key != distance[node])
+		{
+			continue;
+		}
+
+		if (node != source && !recorder.settle(key))
+		{
+			break;
+		}
+
+		for (const auto& [neighbor, weight] : _core.get_neighbors(node))
+		{
+			relax(neighbor, key + weight);
+		}
+
+		for (unsigned i = _first_chain_end[node]; i < _first_chain_end[node + 1]; ++i)
+		{
+			unsigned walk = _chain_end[i];
+			unsigned chain = walk / 2;
+			unsigned length = _chain_length[chain];
+
+			// beyond an interior source, its chain continues as the split chain
+			if (chain == source_chain && walk % 2 == 1)
+			{
+				chain = split_chain;
+				walk = 2 * split_chain + 1;
+			}
+
+			if (chains[chain].epoch != current_epoch)
+			{
+				chains[chain] = { _chain_first[chain], _chain_first[chain + 1], current_epoch, {} };
+			}
+
+			chains[chain].base[walk % 2] = walk % 2 == 0 ? key : key + length;
+			push_walk(walk);
+		}
+	}
+
+	recorder.finish();
+}
+
+void ChainCompression::expand_distances(unsigned source, std::span<const unsigned> core_distances, std::vector<unsigned>& distances) const
+{
+	distances.resize(size());
+
+	for (unsigned core_node = 0; core_node < num_core_nodes(); ++core_node)
+	{
+		distances[_original_node[core_node]] = core_distances[core_node];
+	}
+
+	for (unsigned chain = 0; chain < num_chains(); ++chain)
+	{
+		unsigned tail_distance = core_distances[_chain_tail[chain]];
+		unsigned head_distance = core_distances[_chain_head[chain]];
+
+		for (unsigned slot = _chain_first[chain]; slot < _chain_first[chain + 1]; ++slot)
+		{
+			unsigned u = _chain_node[slot];
+			distances[u] = std::min(add_distance(tail_distance, distance_to_tail(u)), add_distance(head_distance, distance_to_head(u)));
+		}
+	}
+
+	// inside its own chain, the source also reaches nodes directly
+	if (!is_core_node(source))
+	{
+		unsigned chain = _slot_chain[_slot[source]];
+
+		for (unsigned slot = _chain_first[chain]; slot < _chain_first[chain + 1]; ++slot)
+		{
+			unsigned u = _chain_node[slot];
+			distances[u] = std::min(distances[u], distance_along_chain(source, u));
+		}
+	}
+}
+
+double ChainCompression::estimate_optimal_dimension(double guess, unsigned num_to_skip, unsigned min_distance, double tolerance, const PHAST* core_phast, TightCMinimizer minimizer, BallGrowth growth) const
+{
+	growth.num_to_skip = num_to_skip;
+	growth.min_distance = min_distance;
+
+	unsigned pool_size = ThreadPool::instance().size();
+	unsigned round_size = (pool_size + PHAST_LANES - 1) / PHAST_LANES * PHAST_LANES;
+
+	// A source takes at most two lanes, and a sweep leaves at most one lane unused, so a round needs at most this many
+	// sweeps. They, and each worker's core and expanded distances, are charged to the distance matrix budget until the
+	// estimate returns; without room for them, balls are grown without PHAST.
+	unsigned max_sweeps = (2 * round_size + PHAST_LANES - 2) / (PHAST_LANES - 1);
+	size_t sweep_bytes = (size_t(max_sweeps) * PHAST_LANES + pool_size) * num_core_nodes() * sizeof(unsigned) + size_t(pool_size) * size() * sizeof(unsigned);
+
+	DistanceMatrixReservation reservation;
+	if (core_phast != nullptr && !reservation.reserve(sweep_bytes))
+	{
+		core_phast = nullptr;
+	}
+
+	round_size = core_phast == nullptr ? pool_size : round_size;
+
+	std::vector<unsigned> round_sources;
+
+	// source i runs in lanes [first_lane[i], first_lane[i] + its number of core ends), counted across the sweeps
+	std::vector<unsigned> first_lane;
+	std::vector<unsigned> lane_sources;
+	std::vector<std::vector<unsigned>> sweep_distances;
+
+	auto prepare_round = [&](std::span<const unsigned> sources)
+	{
+		round_sources.assign(sources.begin(), sources.end());
+
+		if (core_phast == nullptr)
+		{
+			return;
+		}
+
+		first_lane.clear();
+		lane_sources.clear();
+
+		std::array<CoreEnd, 2> ends;
+
+		for (unsigned source : round_sources)
+		{
+			unsigned num_ends = core_ends(source, ends);
+
+			// the lanes of a source share a sweep; lanes left over run from core node 0 for nobody
+			if (lane_sources.size() % PHAST_LANES + num_ends > PHAST_LANES)
+			{
+				lane_sources.resize((lane_sources.size() / PHAST_LANES + 1) * PHAST_LANES, 0);
+			}
+
+			first_lane.push_back(lane_sources.size());
+
+			for (unsigned e = 0; e < num_ends; ++e)
+			{
+				lane_sources.push_back(ends[e].core_node);
+			}
+		}
+
+		lane_sources.resize((lane_sources.size() + PHAST_LANES - 1) / PHAST_LANES * PHAST_LANES, 0);
+
+		unsigned num_sweeps = lane_sources.size() / PHAST_LANES;
+		sweep_distances.resize(num_sweeps);
+
+		ThreadPool::instance().parallel_for(num_sweeps, 1, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned sweep = first; sweep < last; ++sweep)
+			{
+				core_phast->run<PHAST_LANES>(std::span<const unsigned, PHAST_LANES>(lane_sources.data() + sweep * PHAST_LANES, PHAST_LANES), sweep_distances[sweep]);
+			}
+		});
+	};
+
+	auto source_balls = [&](unsigned i, std::vector<Ball>& balls)
+	{
+		unsigned source = round_sources[i];
+
+		if (core_phast == nullptr)
+		{
+			get_balls(source, balls, growth);
+			return;
+		}
+
+		std::array<CoreEnd, 2> ends;
+		unsigned num_ends = core_ends(source, ends);
+
+		// the source's distance to a core node is the shorter way out through either end of its chain
+		std::vector<unsigned> core_distances(num_core_nodes(), RoutingKit::inf_weight);
+
+		for (unsigned e = 0; e < num_ends; ++e)
+		{
+			unsigned lane = first_lane[i] + e;
+			const auto& lane_distances = sweep_distances[lane / PHAST_LANES];
+
+			for (unsigned core_node = 0; core_node < num_core_nodes(); ++core_node)
+			{
+				unsigned distance = lane_distances[size_t(core_phast->rank(core_node)) * PHAST_LANES + lane % PHAST_LANES];
+				core_distances[core_node] = std::min(core_distances[core_node], add_distance(distance, ends[e].distance));
+			}
+		}
+
+		std::vector<unsigned> distances;
+		expand_distances(source, core_distances, distances);
+		balls = Graph::balls_from_distances(std::move(distances), growth);
+	};
+
+	return Graph::estimate_dimension_in_rounds(size(), round_size, prepare_round, source_balls, guess, num_to_skip, min_distance, tolerance, minimizer);
+}
+
+unsigned ChainCompression::first_slot(unsigned chain, bool from_tail) const noexcept
+{
+	return from_tail ? _chain_first[chain] : _chain_first[chain + 1] - 1;
+}
+
+unsigned ChainCompression::distance_to_tail(unsigned u) const noexcept
+{
+	return _offset[_slot[u]];
+}
+
+unsigned ChainCompression::distance_to_head(unsigned u) const noexcept
+{
+	return _chain_length[_slot_chain[_slot[u]]] - _offset[_slot[u]];
+}
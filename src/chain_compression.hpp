@@ -0,0 +1,108 @@
+#pragma once
+
+#include "graph.hpp"
+#include "phast.hpp"
+
+#include <array>
+#include <span>
+#include <vector>
+
+// a core node an original node reaches without passing any other core node, and how far away it is
+struct CoreEnd
+{
+	unsigned core_node;
+	unsigned distance;
+};
+
+// Road networks are full of degree-2 nodes that only continue a road. A ChainCompression contracts every maximal chain
+// of them into one edge between its two end nodes, weighted with the chain's length. The other nodes, the core nodes,
+// keep their edges among each other, so core() is a much smaller graph with the same distances between core nodes.
+// Each chain keeps its interior nodes in order with their distances from its tail, which is all it takes to map
+// distances, next hops and balls back to the original nodes. Nodes are numbered as in the original graph unless
+// core numbers are asked for.
+class ChainCompression
+{
+public:
+	// Only undirected graphs are compressed; in a directed one every node is a core node. A cycle of degree-2 nodes
+	// with no other node on it keeps the first of them as a core node.
+	explicit ChainCompression(const Graph& graph);
+
+	// over the core numbers, in the order of the original numbers
+	const Graph& core() const noexcept;
+
+	// of the original graph
+	unsigned size() const noexcept;
+
+	unsigned num_core_nodes() const noexcept;
+	unsigned num_chains() const noexcept;
+
+	bool is_core_node(unsigned u) const noexcept;
+
+	// the core number of core node u, and back
+	unsigned core_node(unsigned u) const noexcept;
+	unsigned original_node(unsigned core_node) const noexcept;
+
+	// Fills ends with u itself at distance 0 if it is a core node, or else with the tail and head of its chain (the
+	// same node twice if the chain is a loop); returns how many it filled.
+	unsigned core_ends(unsigned u, std::array<CoreEnd, 2>& ends) const noexcept;
+
+	// the distance from s to t inside the chain both are interior nodes of; inf_weight if they are not on one chain
+	unsigned distance_along_chain(unsigned s, unsigned t) const noexcept;
+
+	// the neighbor of interior node u towards interior node t of the same chain
+	unsigned step_along_chain(unsigned u, unsigned t) const noexcept;
+
+	// the neighbor of interior node u towards the end of its chain that is core node end (of a loop, the nearer way)
+	unsigned step_towards_end(unsigned u, unsigned end) const noexcept;
+
+	// the interior node that follows core node end on the way into the chain of interior node t (of a loop, the nearer way)
+	unsigned step_into_chain(unsigned end, unsigned t) const noexcept;
+
+	// the node that follows core node u on the lightest edge or chain to core node v, which core() connects to u
+	unsigned step_towards_core_node(unsigned u, unsigned v) const noexcept;
+
+	// The same balls as Graph::get_balls over the original graph. Dijkstra only runs over the core; every chain is
+	// walked inward from each of its ends once the end is settled, one interior node per heap operation, until the
+	// two walks meet. Same thread_local, epoch-stamped workspace as Graph::get_balls.
+	void get_balls(unsigned u, std::vector<Ball>& balls, const BallGrowth& growth = {}) const;
+
+	// the distances from source to every original node, given its distances to every core node by core number
+	void expand_distances(unsigned source, std::span<const unsigned> core_distances, std::vector<unsigned>& distances) const;
+
+	// Graph::estimate_optimal_dimension of the original graph, with PHAST running over core()'s contraction hierarchy.
+	// A source inside a chain takes two PHAST lanes, one for each end of its chain.
+	double estimate_optimal_dimension(double guess = 1.5, unsigned num_to_skip = 0, unsigned min_distance = 0, double tolerance = 2e-3, const PHAST* core_phast = nullptr, TightCMinimizer minimizer = TightCMinimizer::BRENT, BallGrowth growth = {}) const;
+
+private:
+	// the slot of the chain's interior node next to its tail, or to its head
+	unsigned first_slot(unsigned chain, bool from_tail) const noexcept;
+
+	// an interior node's distance along its chain to either end
+	unsigned distance_to_tail(unsigned u) const noexcept;
+	unsigned distance_to_head(unsigned u) const noexcept;
+
+	Graph _core;
+
+	// by original node: its core number, or for an interior node its slot in the chain arrays (invalid_id otherwise)
+	std::vector<unsigned> _core_node;
+	std::vector<unsigned> _slot;
+
+	// by core number
+	std::vector<unsigned> _original_node;
+
+	// The interior nodes of chain c fill slots [_chain_first[c], _chain_first[c + 1]) from tail to head, with their
+	// distances from the tail in _offset and their chain in _slot_chain. Tails and heads are core numbers.
+	std::vector<unsigned> _chain_first;
+	std::vector<unsigned> _chain_tail;
+	std::vector<unsigned> _chain_head;
+	std::vector<unsigned> _chain_length;
+
+	std::vector<unsigned> _chain_node;
+	std::vector<unsigned> _offset;
+	std::vector<unsigned> _slot_chain;
+
+	// the chain ends at core number u are _chain_end[_first_chain_end[u], _first_chain_end[u + 1]), each 2 * chain
+	// if u is the chain's tail and 2 * chain + 1 if it is its head
+	std::vector<unsigned> _first_chain_end;
+	std::vector<unsigned> _chain_end;
+};
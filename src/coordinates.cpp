@@ -0,0 +1,35 @@
+#include "coordinates.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace
+{
+	const double EARTH_RADIUS_CENTIMETRES = 6'371'008.8 * 100.0;
+
+	double to_radians(int32_t microdegrees) noexcept
+	{
+		return microdegrees * 1e-6 * std::numbers::pi / 180.0;
+	}
+}
+
+unsigned euclidean_distance(Coordinate a, Coordinate b) noexcept
+{
+	double dx = double(a.longitude) - b.longitude;
+	double dy = double(a.latitude) - b.latitude;
+
+	return std::lround(std::sqrt(dx * dx + dy * dy));
+}
+
+unsigned great_circle_distance(Coordinate a, Coordinate b) noexcept
+{
+	double latitude_a = to_radians(a.latitude);
+	double latitude_b = to_radians(b.latitude);
+	double sin_half_latitude = std::sin((latitude_b - latitude_a) / 2);
+	double sin_half_longitude = std::sin((to_radians(b.longitude) - to_radians(a.longitude)) / 2);
+
+	double h = sin_half_latitude * sin_half_latitude + std::cos(latitude_a) * std::cos(latitude_b) * sin_half_longitude * sin_half_longitude;
+
+	return std::lround(2 * EARTH_RADIUS_CENTIMETRES * std::asin(std::sqrt(std::min(h, 1.0))));
+}
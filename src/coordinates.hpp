@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// A node's position as in a DIMACS .co file: longitude and latitude in millionths of a degree
+struct Coordinate
+{
+	int32_t longitude;
+	int32_t latitude;
+};
+
+// straight-line distance in the plane of the raw coordinates, in millionths of a degree
+unsigned euclidean_distance(Coordinate a, Coordinate b) noexcept;
+
+// haversine distance on a spherical Earth, in centimetres (half the circumference still fits in 32 bits)
+unsigned great_circle_distance(Coordinate a, Coordinate b) noexcept;
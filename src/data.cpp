@@ -4,10 +4,10 @@
 #include <sstream>
 #include <string>
 
-void save_clustering_exponent_data(const std::string& name, unsigned k, unsigned Q, double clustering_exponent, double average_greedy_path_length)
+void save_clustering_exponent_data(const std::string& name, unsigned k, unsigned Q, double clustering_exponent, double average_greedy_path_length, double standard_error, unsigned num_trials)
 {
 	std::ofstream file(DATA_DIRECTORY + CLUSTERING_EXPONENT_DATA_FILENAME, std::ios::app);
-	file << name << "," << k << "," << Q << "," << clustering_exponent << "," << average_greedy_path_length << std::endl;
+	file << name << "," << k << "," << Q << "," << clustering_exponent << "," << average_greedy_path_length << "," << standard_error << "," << num_trials << std::endl;
 }
 
 void save_optimal_clustering_exponent_data(const std::string& name, unsigned k, unsigned Q, double optimal_clustering_exponent)
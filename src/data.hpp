@@ -12,7 +12,7 @@ static const std::string OPTIMAL_CLUSTERING_EXPONENT_DATA_FILENAME = "optimal-cl
 static const std::string DIMENSION_DATA_FILENAME = "dimension" + CSV_EXTENSION;
 static const std::string OPTIMAL_VS_DIMENSION_DATA_FILENAME = "optimal-vs-dimension" + CSV_EXTENSION;
 
-void save_clustering_exponent_data(const std::string& name, unsigned k, unsigned Q, double clustering_exponent, double average_greedy_path_length);
+void save_clustering_exponent_data(const std::string& name, unsigned k, unsigned Q, double clustering_exponent, double average_greedy_path_length, double standard_error, unsigned num_trials);
 
 void save_optimal_clustering_exponent_data(const std::string& name, unsigned k, unsigned Q, double optimal_clustering_exponent);
 
@@ -0,0 +1,186 @@
+#include "distance_oracle.hpp"
+
+#include "thread_local_query.hpp"
+
+#include <routingkit/constants.h>
+#include <routingkit/contraction_hierarchy.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace
+{
+	// a CH query over the core from every core end of s to every core end of t, ready to run
+	RoutingKit::ContractionHierarchyQuery& core_query(RoutingKit::ContractionHierarchyQuery& ch_query, const ChainCompression& compression, unsigned s, unsigned t) noexcept
+	{
+		std::array<CoreEnd, 2> ends;
+
+		ch_query.reset();
+
+		for (unsigned i = 0, num_ends = compression.core_ends(s, ends); i < num_ends; ++i)
+		{
+			ch_query.add_source(ends[i].core_node, ends[i].distance);
+		}
+
+		for (unsigned i = 0, num_ends = compression.core_ends(t, ends); i < num_ends; ++i)
+		{
+			ch_query.add_target(ends[i].core_node, ends[i].distance);
+		}
+
+		return ch_query;
+	}
+}
+
+ContractionHierarchyOracle::ContractionHierarchyOracle(const RoutingKit::ContractionHierarchy& ch) :
+	_contraction_hierarchy(&ch)
+{
+}
+
+const RoutingKit::ContractionHierarchy& ContractionHierarchyOracle::contraction_hierarchy() const noexcept
+{
+	return *_contraction_hierarchy;
+}
+
+unsigned ContractionHierarchyOracle::size() const noexcept
+{
+	return _contraction_hierarchy->node_count();
+}
+
+unsigned ContractionHierarchyOracle::distance(unsigned s, unsigned t) const noexcept
+{
+	auto& ch_query = get_thread_local_query<0>(*_contraction_hierarchy);
+	return ch_query.reset().add_source(s).add_target(t).run().get_distance();
+}
+
+unsigned ContractionHierarchyOracle::next_hop(unsigned s, unsigned t) const noexcept
+{
+	if (s == t)
+	{
+		return s;
+	}
+
+	auto& ch_query = get_thread_local_query<3>(*_contraction_hierarchy);
+	return ch_query.reset().add_source(s).add_target(t).run().get_node_path()[1];
+}
+
+void ContractionHierarchyOracle::one_to_many(unsigned source, const std::vector<unsigned>& targets, std::vector<unsigned>& distances) const noexcept
+{
+	auto& ch_query = get_thread_local_query<2>(*_contraction_hierarchy);
+	distances = ch_query.reset().add_source(source).pin_targets(targets).run_to_pinned_targets().get_distances_to_targets();
+}
+
+ChainCompressionOracle::ChainCompressionOracle(const ChainCompression& compression, const RoutingKit::ContractionHierarchy& core_ch) :
+	_compression(&compression), _core_contraction_hierarchy(&core_ch)
+{
+}
+
+const ChainCompression& ChainCompressionOracle::compression() const noexcept
+{
+	return *_compression;
+}
+
+unsigned ChainCompressionOracle::size() const noexcept
+{
+	return _compression->size();
+}
+
+unsigned ChainCompressionOracle::distance(unsigned s, unsigned t) const noexcept
+{
+	if (s == t)
+	{
+		return 0;
+	}
+
+	auto& ch_query = get_thread_local_query<4>(*_core_contraction_hierarchy);
+	unsigned distance = core_query(ch_query, *_compression, s, t).run().get_distance();
+
+	return std::min(distance, _compression->distance_along_chain(s, t));
+}
+
+unsigned ChainCompressionOracle::next_hop(unsigned s, unsigned t) const noexcept
+{
+	if (s == t)
+	{
+		return s;
+	}
+
+	auto& ch_query = get_thread_local_query<5>(*_core_contraction_hierarchy);
+	unsigned distance = core_query(ch_query, *_compression, s, t).run().get_distance();
+
+	// staying inside a shared chain
+	unsigned distance_along_chain = _compression->distance_along_chain(s, t);
+	if (distance_along_chain != RoutingKit::inf_weight && distance_along_chain <= distance)
+	{
+		return _compression->step_along_chain(s, t);
+	}
+
+	// out of the chain of s, towards the end the shortest path leaves it by
+	if (!_compression->is_core_node(s))
+	{
+		return _compression->step_towards_end(s, ch_query.get_used_source());
+	}
+
+	// a core node that is itself the end the shortest path enters the chain of t by
+	auto path = ch_query.get_node_path();
+	if (path.size() == 1)
+	{
+		return _compression->step_into_chain(path[0], t);
+	}
+
+	return _compression->step_towards_core_node(path[0], path[1]);
+}
+
+void ChainCompressionOracle::one_to_many(unsigned source, const std::vector<unsigned>& targets, std::vector<unsigned>& distances) const noexcept
+{
+	thread_local std::vector<unsigned> core_targets;
+	thread_local std::vector<unsigned> core_distances;
+
+	// every core end of a target once, so that the targets of one chain share their pinned ends
+	std::array<CoreEnd, 2> ends;
+	core_targets.clear();
+
+	for (unsigned target : targets)
+	{
+		for (unsigned i = 0, num_ends = _compression->core_ends(target, ends); i < num_ends; ++i)
+		{
+			core_targets.push_back(ends[i].core_node);
+		}
+	}
+
+	std::sort(core_targets.begin(), core_targets.end());
+	core_targets.erase(std::unique(core_targets.begin(), core_targets.end()), core_targets.end());
+
+	auto& ch_query = get_thread_local_query<6>(*_core_contraction_hierarchy);
+	ch_query.reset();
+
+	for (unsigned i = 0, num_ends = _compression->core_ends(source, ends); i < num_ends; ++i)
+	{
+		ch_query.add_source(ends[i].core_node, ends[i].distance);
+	}
+
+	core_distances = ch_query.pin_targets(core_targets).run_to_pinned_targets().get_distances_to_targets();
+
+	auto core_distance = [&](unsigned core_node)
+	{
+		return core_distances[std::lower_bound(core_targets.begin(), core_targets.end(), core_node) - core_targets.begin()];
+	};
+
+	distances.resize(targets.size());
+
+	for (unsigned i = 0; i < targets.size(); ++i)
+	{
+		unsigned distance = targets[i] == source ? 0 : _compression->distance_along_chain(source, targets[i]);
+
+		for (unsigned j = 0, num_ends = _compression->core_ends(targets[i], ends); j < num_ends; ++j)
+		{
+			unsigned end_distance = core_distance(ends[j].core_node);
+			if (end_distance != RoutingKit::inf_weight)
+			{
+				distance = std::min(distance, end_distance + ends[j].distance);
+			}
+		}
+
+		distances[i] = distance;
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "chain_compression.hpp"
+#include "implicit_lattice.hpp"
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// What Highway needs from a graph's shortest paths: the distance between two nodes, the first hop of a shortest
+// path between them (s itself if s == t), and the distances from one node to many.
+template <typename Oracle>
+concept DistanceOracle = std::copy_constructible<Oracle> && requires(const Oracle& oracle, unsigned node, const std::vector<unsigned>& targets, std::vector<unsigned>& distances)
+{
+	{ oracle.size() } -> std::convertible_to<unsigned>;
+	{ oracle.distance(node, node) } -> std::convertible_to<unsigned>;
+	{ oracle.next_hop(node, node) } -> std::convertible_to<unsigned>;
+	oracle.one_to_many(node, targets, distances);
+};
+
+// Distances from CH queries, each kept in a thread_local query per call site. Only refers to the hierarchy.
+class ContractionHierarchyOracle
+{
+public:
+	ContractionHierarchyOracle(const RoutingKit::ContractionHierarchy& ch);
+
+	const RoutingKit::ContractionHierarchy& contraction_hierarchy() const noexcept;
+
+	unsigned size() const noexcept;
+
+	unsigned distance(unsigned s, unsigned t) const noexcept;
+
+	unsigned next_hop(unsigned s, unsigned t) const noexcept;
+
+	// unreachable targets get inf_weight
+	void one_to_many(unsigned source, const std::vector<unsigned>& targets, std::vector<unsigned>& distances) const noexcept;
+
+private:
+	const RoutingKit::ContractionHierarchy* _contraction_hierarchy;
+};
+
+// Distances over a ChainCompression: CH queries over the hierarchy of its core, which enter and leave it at the ends
+// of the chains the endpoints lie on. Nodes keep their original numbers, so next hops go through a chain one node at
+// a time. Only refers to the compression and the hierarchy. A Highway over it asks for every distance and next hop
+// separately, each a core CH query, without the REVERSE_TREE, PHAST or landmark paths of ContractionHierarchyOracle;
+// greedy routing on road networks is faster over the full hierarchy, so the drivers only compress for ball growth.
+class ChainCompressionOracle
+{
+public:
+	ChainCompressionOracle(const ChainCompression& compression, const RoutingKit::ContractionHierarchy& core_ch);
+
+	const ChainCompression& compression() const noexcept;
+
+	unsigned size() const noexcept;
+
+	unsigned distance(unsigned s, unsigned t) const noexcept;
+
+	unsigned next_hop(unsigned s, unsigned t) const noexcept;
+
+	// unreachable targets get inf_weight
+	void one_to_many(unsigned source, const std::vector<unsigned>& targets, std::vector<unsigned>& distances) const noexcept;
+
+private:
+	const ChainCompression* _compression;
+	const RoutingKit::ContractionHierarchy* _core_contraction_hierarchy;
+};
+
+// Distances in an ImplicitLattice, all arithmetic: no graph, no hierarchy and no search. Node ids are 32-bit, so
+// the lattice must have fewer than 2^32 nodes; the constructor throws std::length_error otherwise.
+template <unsigned DIMENSION>
+class LatticeOracle
+{
+public:
+	LatticeOracle(const ImplicitLattice<DIMENSION>& lattice) :
+		_lattice(lattice)
+	{
+		if (_lattice.size() > std::numeric_limits<unsigned>::max())
+		{
+			throw std::length_error("a lattice of side length " + std::to_string(_lattice.side_length()) + " has " + std::to_string(_lattice.size()) + " nodes, too many for 32-bit node ids");
+		}
+	}
+
+	// whether a lattice of this side length has few enough nodes for the constructor, without building it
+	static bool fits(uint64_t side_length) noexcept
+	{
+		if (side_length > std::numeric_limits<unsigned>::max())
+		{
+			return false;
+		}
+
+		uint64_t size = 1;
+
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			// size and side_length are both below 2^32 here, so the product cannot overflow
+			size *= side_length;
+
+			if (size > std::numeric_limits<unsigned>::max())
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	const ImplicitLattice<DIMENSION>& lattice() const noexcept
+	{
+		return _lattice;
+	}
+
+	unsigned size() const noexcept
+	{
+		return _lattice.size();
+	}
+
+	unsigned distance(unsigned s, unsigned t) const noexcept
+	{
+		return _lattice.distance(s, t);
+	}
+
+	unsigned next_hop(unsigned s, unsigned t) const noexcept
+	{
+		return _lattice.next_hop(s, t);
+	}
+
+	void one_to_many(unsigned source, const std::vector<unsigned>& targets, std::vector<unsigned>& distances) const noexcept
+	{
+		distances.resize(targets.size());
+
+		for (unsigned i = 0; i < targets.size(); ++i)
+		{
+			distances[i] = _lattice.distance(source, targets[i]);
+		}
+	}
+
+private:
+	ImplicitLattice<DIMENSION> _lattice;
+};
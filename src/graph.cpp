@@ -1,139 +1,759 @@
 #include "graph.hpp"
+#include "ball_profile.hpp"
+#include "ball_recorder.hpp"
 #include "data.hpp"
+#include "highway_distance_matrix.hpp"
+#include "mapped_file.hpp"
+#include "radix_heap.hpp"
+#include "running_median.hpp"
+#include "thread_pool.hpp"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <queue>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <random>
+#include <span>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_min.h>
 
+#include <routingkit/constants.h>
 #include <routingkit/contraction_hierarchy.h>
 
 #include <stdio.h>
 
-Graph::Graph(unsigned num_nodes, bool directed) :
-	_neighbors(num_nodes), _directed(directed), _num_edges(0)
+GraphBuilder::GraphBuilder(unsigned num_nodes, bool directed) :
+	_num_nodes(num_nodes), _directed(directed)
 {
 }
 
-void Graph::add_edge(unsigned u, unsigned v, unsigned weight)
+void GraphBuilder::add_edge(unsigned u, unsigned v, unsigned weight)
 {
-	++_num_edges;
-	_neighbors[u][v] = weight;
+	_tails.push_back(u);
+	_heads.push_back(v);
+	_weights.push_back(weight);
 
 	if (!_directed)
 	{
-		_neighbors[v][u] = weight;
+		_tails.push_back(v);
+		_heads.push_back(u);
+		_weights.push_back(weight);
 	}
 }
 
-const std::unordered_map<unsigned, unsigned>& Graph::get_neighbors(unsigned u) const
+void GraphBuilder::append(GraphBuilder&& other)
 {
-	return _neighbors[u];
-}
+	_tails.insert(_tails.end(), other._tails.begin(), other._tails.end());
+	_heads.insert(_heads.end(), other._heads.begin(), other._heads.end());
+	_weights.insert(_weights.end(), other._weights.begin(), other._weights.end());
 
-unsigned Graph::size() const noexcept
-{
-	return _neighbors.size();
+	other._tails = {};
+	other._heads = {};
+	other._weights = {};
 }
 
-unsigned Graph::num_edges() const noexcept
+unsigned GraphBuilder::size() const noexcept
 {
-	return _num_edges;
+	return _num_nodes;
 }
 
-RoutingKit::ContractionHierarchy Graph::get_contraction_hierarchy() const
+namespace
 {
-	std::vector<unsigned> tail, head, dist;
+	struct GraphArrays
+	{
+		std::vector<unsigned> first_out;
+		std::vector<unsigned> head;
+		std::vector<unsigned> weight;
+		std::vector<unsigned> component;
+		std::vector<unsigned> component_size;
+	};
+
+	const char GRAPH_FILE_MAGIC[8] = { 'F', 'G', 'R', 'G', 'R', 'A', 'P', 'H' };
+
+	// 40 bytes, so the arrays that follow it stay aligned
+	struct GraphFileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t directed;
+		uint64_t num_nodes;
+		uint64_t num_arcs;
+		uint64_t num_components;
+	};
+
+	// Parallel union-find over the arcs, taken as undirected. A root is only ever linked under a smaller root, by a
+	// compare-and-swap that fails if it stopped being a root, and finds halve their paths as they go. Labels every
+	// node with the root of its component.
+	void find_weak_roots(std::span<const unsigned> first_out, std::span<const unsigned> head, std::vector<unsigned>& component)
+	{
+		unsigned num_nodes = first_out.size() - 1;
+		auto& pool = ThreadPool::instance();
+
+		std::vector<std::atomic<unsigned>> parent(num_nodes);
+
+		auto find = [&parent](unsigned u)
+		{
+			while (true)
+			{
+				unsigned p = parent[u].load();
+				unsigned grandparent = parent[p].load();
+
+				if (p == grandparent)
+				{
+					return p;
+				}
+
+				parent[u].compare_exchange_weak(p, grandparent);
+				u = grandparent;
+			}
+		};
+
+		pool.parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned u = first; u < last; ++u)
+			{
+				parent[u].store(u);
+			}
+		});
+
+		pool.parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned u = first; u < last; ++u)
+			{
+				for (unsigned arc = first_out[u]; arc < first_out[u + 1]; ++arc)
+				{
+					unsigned a = find(u);
+					unsigned b = find(head[arc]);
+
+					while (a != b)
+					{
+						if (a < b)
+						{
+							std::swap(a, b);
+						}
+
+						unsigned expected = a;
+						if (parent[a].compare_exchange_strong(expected, b))
+						{
+							break;
+						}
+
+						a = find(a);
+						b = find(b);
+					}
+				}
+			}
+		});
+
+		component.resize(num_nodes);
+
+		pool.parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned u = first; u < last; ++u)
+			{
+				component[u] = find(u);
+			}
+		});
+	}
+
+	// Tarjan's algorithm, with an explicit stack of (node, next arc) in place of recursion, which road networks
+	// would overflow. Labels every node with the root of its strongly connected component: the first node of it that
+	// the search reached.
+	void find_strong_roots(std::span<const unsigned> first_out, std::span<const unsigned> head, std::vector<unsigned>& component)
+	{
+		unsigned num_nodes = first_out.size() - 1;
+
+		std::vector<unsigned> index(num_nodes, RoutingKit::invalid_id);
+		std::vector<unsigned> low_link(num_nodes);
+		std::vector<bool> is_on_stack(num_nodes, false);
+		std::vector<unsigned> stack;
+		std::vector<std::pair<unsigned, unsigned>> calls;
+		unsigned next_index = 0;
+
+		component.resize(num_nodes);
+
+		auto visit = [&](unsigned u)
+		{
+			index[u] = low_link[u] = next_index++;
+			stack.push_back(u);
+			is_on_stack[u] = true;
+			calls.push_back({ u, first_out[u] });
+		};
+
+		for (unsigned root = 0; root < num_nodes; ++root)
+		{
+			if (index[root] != RoutingKit::invalid_id)
+			{
+				continue;
+			}
+
+			visit(root);
+
+			while (!calls.empty())
+			{
+				auto& [u, arc] = calls.back();
+
+				if (arc < first_out[u + 1])
+				{
+					unsigned v = head[arc++];
+
+					if (index[v] == RoutingKit::invalid_id)
+					{
+						visit(v);
+					}
+					else if (is_on_stack[v])
+					{
+						low_link[u] = std::min(low_link[u], index[v]);
+					}
+
+					continue;
+				}
+
+				unsigned finished = u;
+				calls.pop_back();
+
+				// finished is the root of its component, which is everything above it on the stack
+				if (low_link[finished] == index[finished])
+				{
+					unsigned w;
+					do
+					{
+						w = stack.back();
+						stack.pop_back();
+						is_on_stack[w] = false;
+						component[w] = finished;
+					} while (w != finished);
+				}
 
-	for (unsigned u = 0; u < _neighbors.size(); ++u)
+				if (!calls.empty())
+				{
+					unsigned parent = calls.back().first;
+					low_link[parent] = std::min(low_link[parent], low_link[finished]);
+				}
+			}
+		}
+	}
+
+	// Components of an undirected graph, strongly connected ones of a directed graph, so that every node of a
+	// component reaches every other. They are numbered by decreasing size.
+	void label_components(std::span<const unsigned> first_out, std::span<const unsigned> head, bool directed, std::vector<unsigned>& component, std::vector<unsigned>& component_size)
 	{
-		for (const auto& [v, weight] : _neighbors[u])
+		unsigned num_nodes = first_out.size() - 1;
+		auto& pool = ThreadPool::instance();
+
+		if (directed)
+		{
+			find_strong_roots(first_out, head, component);
+		}
+		else
+		{
+			find_weak_roots(first_out, head, component);
+		}
+
+		// number the roots by decreasing size, ties by root
+		std::vector<unsigned> root_size(num_nodes, 0);
+		for (unsigned root : component)
 		{
-			head.push_back(u);
-			tail.push_back(v);
-			dist.push_back(weight);
+			++root_size[root];
 		}
+
+		std::vector<unsigned> roots;
+		for (unsigned u = 0; u < num_nodes; ++u)
+		{
+			if (root_size[u] > 0)
+			{
+				roots.push_back(u);
+			}
+		}
+
+		std::sort(roots.begin(), roots.end(), [&](unsigned a, unsigned b) { return root_size[a] > root_size[b] || (root_size[a] == root_size[b] && a < b); });
+
+		component_size.resize(roots.size());
+		for (unsigned c = 0; c < roots.size(); ++c)
+		{
+			component_size[c] = root_size[roots[c]];
+			root_size[roots[c]] = c;
+		}
+
+		pool.parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned u = first; u < last; ++u)
+			{
+				component[u] = root_size[component[u]];
+			}
+		});
 	}
 
-	return RoutingKit::ContractionHierarchy::build(_neighbors.size(), tail, head, dist);
+	// Dijkstra workspace for get_balls; a node's distance is only valid if its epoch is the current one
+	struct BallSearch
+	{
+		std::vector<unsigned> distance;
+		std::vector<unsigned> epoch;
+		unsigned current_epoch = 0;
+		RadixHeap<unsigned> queue;
+
+		void reset(unsigned num_nodes)
+		{
+			if (epoch.size() != num_nodes || ++current_epoch == 0)
+			{
+				distance.assign(num_nodes, 0);
+				epoch.assign(num_nodes, 0);
+				current_epoch = 1;
+			}
+
+			queue.clear();
+		}
+	};
+
+	// y = slope * x + intercept
+	struct Line
+	{
+		double slope;
+		double intercept;
+
+		double operator()(double x) const noexcept
+		{
+			return slope * x + intercept;
+		}
+	};
+
+	double intersection(const Line& a, const Line& b) noexcept
+	{
+		return (b.intercept - a.intercept) / (a.slope - b.slope);
+	}
+
+	// the lines that are the maximum somewhere, from left to right; line i is the maximum between breakpoints[i - 1] and breakpoints[i]
+	void upper_envelope(std::vector<Line> lines, std::vector<Line>& envelope, std::vector<double>& breakpoints)
+	{
+		std::sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.slope < b.slope || (a.slope == b.slope && a.intercept < b.intercept); });
+
+		envelope.clear();
+		for (const Line& line : lines)
+		{
+			// of parallel lines, only the highest (the last) counts
+			if (!envelope.empty() && envelope.back().slope == line.slope)
+			{
+				envelope.pop_back();
+			}
+
+			// the last line is never the maximum if the new one overtakes the one before it no later than it does
+			while (envelope.size() >= 2 && intersection(envelope[envelope.size() - 2], line) <= intersection(envelope[envelope.size() - 2], envelope.back()))
+			{
+				envelope.pop_back();
+			}
+
+			envelope.push_back(line);
+		}
+
+		breakpoints.clear();
+		for (unsigned i = 0; i + 1 < envelope.size(); ++i)
+		{
+			breakpoints.push_back(intersection(envelope[i], envelope[i + 1]));
+		}
+	}
+
+	// words hashed per parallel block by content_hash
+	const unsigned HASH_BLOCK_SIZE = 1 << 16;
+
+	// one round of xxHash64
+	uint64_t hash_round(uint64_t hash, uint64_t word) noexcept
+	{
+		hash += word * 0xC2B2AE3D27D4EB4FULL;
+		hash = (hash << 31) | (hash >> 33);
+		return hash * 0x9E3779B185EBCA87ULL;
+	}
+
+	// hashes blocks of the array in parallel, then the block hashes in order
+	uint64_t hash_array(std::span<const unsigned> array)
+	{
+		unsigned num_blocks = (array.size() + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+		std::vector<uint64_t> block_hashes(num_blocks);
+
+		ThreadPool::instance().parallel_for(num_blocks, 1, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned block = first; block < last; ++block)
+			{
+				uint64_t hash = block;
+				for (size_t i = size_t(block) * HASH_BLOCK_SIZE; i < std::min(array.size(), size_t(block + 1) * HASH_BLOCK_SIZE); ++i)
+				{
+					hash = hash_round(hash, array[i]);
+				}
+
+				block_hashes[block] = hash;
+			}
+		});
+
+		uint64_t hash = array.size();
+		for (uint64_t block_hash : block_hashes)
+		{
+			hash = hash_round(hash, block_hash);
+		}
+
+		return hash;
+	}
 }
 
-std::vector<Ball> Graph::get_balls(unsigned u) const
+Graph::Graph(GraphBuilder&& builder) :
+	_directed(builder._directed)
 {
-	std::vector<bool> visited(_neighbors.size(), false);
+	auto arrays = std::make_shared<GraphArrays>();
+	auto& first_out = arrays->first_out;
+	auto& head = arrays->head;
+	auto& weight = arrays->weight;
 
-	std::vector<Ball> balls;
-	std::priority_queue<std::pair<unsigned, unsigned>> pq;
-	pq.push({0, u});
+	unsigned num_nodes = builder._num_nodes;
+	unsigned num_arcs = builder._tails.size();
+
+	// counting sort the arcs into rows by tail
+	std::vector<unsigned> row_start(num_nodes + 1, 0);
 
-	unsigned visited_count = 0;
-	while (!pq.empty())
+	for (unsigned tail : builder._tails)
 	{
-		auto [distance, node] = pq.top();
-		distance = -distance;
-		pq.pop();
+		++row_start[tail + 1];
+	}
 
-		if (visited[node])
+	for (unsigned u = 0; u < num_nodes; ++u)
+	{
+		row_start[u + 1] += row_start[u];
+	}
+
+	std::vector<std::pair<unsigned, unsigned>> arcs(num_arcs);
+	std::vector<unsigned> next_arc(row_start.begin(), row_start.end() - 1);
+
+	for (unsigned i = 0; i < num_arcs; ++i)
+	{
+		arcs[next_arc[builder._tails[i]]++] = { builder._heads[i], builder._weights[i] };
+	}
+
+	builder._tails = {};
+	builder._heads = {};
+	builder._weights = {};
+
+	auto& pool = ThreadPool::instance();
+	std::vector<unsigned> row_size(num_nodes);
+
+	// sort each row by (head, weight), so that the first of every run of parallel arcs is the lightest, and keep only that one
+	pool.parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+	{
+		for (unsigned u = first; u < last; ++u)
 		{
-			continue;
+			auto row_begin = arcs.begin() + row_start[u];
+			auto row_end = arcs.begin() + row_start[u + 1];
+
+			std::sort(row_begin, row_end);
+
+			auto unique_end = std::unique(row_begin, row_end, [](const auto& a, const auto& b) { return a.first == b.first; });
+			row_size[u] = unique_end - row_begin;
 		}
+	});
+
+	first_out.assign(num_nodes + 1, 0);
+	for (unsigned u = 0; u < num_nodes; ++u)
+	{
+		first_out[u + 1] = first_out[u] + row_size[u];
+	}
+
+	head.resize(first_out[num_nodes]);
+	weight.resize(first_out[num_nodes]);
 
-		visited[node] = true;
-		if (node != u)
+	pool.parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+	{
+		for (unsigned u = first; u < last; ++u)
 		{
-			++visited_count;
-			balls.push_back({distance, visited_count});
+			for (unsigned i = 0; i < row_size[u]; ++i)
+			{
+				head[first_out[u] + i] = arcs[row_start[u] + i].first;
+				weight[first_out[u] + i] = arcs[row_start[u] + i].second;
+			}
 		}
+	});
+
+	label_components(first_out, head, _directed, arrays->component, arrays->component_size);
+
+	_first_out = first_out;
+	_head = head;
+	_weight = weight;
+	_component = arrays->component;
+	_component_size = arrays->component_size;
+	_storage = std::move(arrays);
+}
+
+Graph::Graph(std::shared_ptr<const void> storage, std::span<const unsigned> first_out, std::span<const unsigned> head, std::span<const unsigned> weight, std::span<const unsigned> component, std::span<const unsigned> component_size, bool directed) noexcept :
+	_storage(std::move(storage)), _first_out(first_out), _head(head), _weight(weight), _component(component), _component_size(component_size), _directed(directed)
+{
+}
+
+std::optional<Graph> Graph::load_file(const std::string& path)
+{
+	auto file = std::make_shared<MappedFile>(path);
+	if (!file->is_open() || file->size() < sizeof(GraphFileHeader))
+	{
+		return std::nullopt;
+	}
+
+	GraphFileHeader header;
+	std::memcpy(&header, file->data(), sizeof(header));
+
+	if (std::memcmp(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != GRAPH_FILE_VERSION)
+	{
+		return std::nullopt;
+	}
+
+	if (file->size() != sizeof(header) + (2 * header.num_nodes + 1 + 2 * header.num_arcs + header.num_components) * sizeof(unsigned))
+	{
+		return std::nullopt;
+	}
+
+	// mmap returns page-aligned memory and the header keeps the arrays 4-byte aligned
+	auto arrays = reinterpret_cast<const unsigned*>(file->data() + sizeof(header));
+	std::span<const unsigned> first_out(arrays, header.num_nodes + 1);
+	std::span<const unsigned> head(first_out.data() + first_out.size(), header.num_arcs);
+	std::span<const unsigned> weight(head.data() + head.size(), header.num_arcs);
+	std::span<const unsigned> component(weight.data() + weight.size(), header.num_nodes);
+	std::span<const unsigned> component_size(component.data() + component.size(), header.num_components);
+
+	if (first_out.back() != header.num_arcs)
+	{
+		return std::nullopt;
+	}
+
+	return Graph(std::move(file), first_out, head, weight, component, component_size, header.directed != 0);
+}
+
+void Graph::save_file(const std::string& path) const
+{
+	GraphFileHeader header;
+	std::memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic));
+	header.version = GRAPH_FILE_VERSION;
+	header.directed = _directed;
+	header.num_nodes = size();
+	header.num_arcs = _head.size();
+	header.num_components = _component_size.size();
+
+	// written under a temporary name and renamed, so that a concurrent load_file never maps a partial file
+	std::string temporary_path = path + ".tmp";
+	{
+		std::ofstream file(temporary_path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(_first_out.data()), _first_out.size_bytes());
+		file.write(reinterpret_cast<const char*>(_head.data()), _head.size_bytes());
+		file.write(reinterpret_cast<const char*>(_weight.data()), _weight.size_bytes());
+		file.write(reinterpret_cast<const char*>(_component.data()), _component.size_bytes());
+		file.write(reinterpret_cast<const char*>(_component_size.data()), _component_size.size_bytes());
+	}
+
+	std::filesystem::rename(temporary_path, path);
+}
+
+uint64_t Graph::content_hash() const
+{
+	uint64_t hash = hash_round(size(), _directed);
+	hash = hash_round(hash, hash_array(_first_out));
+	hash = hash_round(hash, hash_array(_head));
+	return hash_round(hash, hash_array(_weight));
+}
+
+Graph Graph::renumbered(std::span<const unsigned> order) const
+{
+	unsigned num_nodes = size();
 
-		for (const auto& [neighbor, weight] : _neighbors[node])
+	std::vector<unsigned> position(num_nodes);
+	for (unsigned i = 0; i < num_nodes; ++i)
+	{
+		position[order[i]] = i;
+	}
+
+	auto arrays = std::make_shared<GraphArrays>();
+	auto& first_out = arrays->first_out;
+
+	first_out.assign(num_nodes + 1, 0);
+	for (unsigned i = 0; i < num_nodes; ++i)
+	{
+		first_out[i + 1] = first_out[i] + get_neighbors(order[i]).size();
+	}
+
+	arrays->head.resize(_head.size());
+	arrays->weight.resize(_weight.size());
+	arrays->component.resize(num_nodes);
+	arrays->component_size.assign(_component_size.begin(), _component_size.end());
+
+	// rows stay sorted by head, as the arcs of a Graph are
+	ThreadPool::instance().parallel_for(num_nodes, 1024, [&](unsigned first, unsigned last, unsigned)
+	{
+		std::vector<std::pair<unsigned, unsigned>> row;
+
+		for (unsigned i = first; i < last; ++i)
 		{
-			if (!visited[neighbor])
+			row.clear();
+			for (const auto& [head, weight] : get_neighbors(order[i]))
+			{
+				row.push_back({ position[head], weight });
+			}
+
+			std::sort(row.begin(), row.end());
+
+			for (unsigned j = 0; j < row.size(); ++j)
 			{
-				pq.push({-distance - weight, neighbor});
+				arrays->head[first_out[i] + j] = row[j].first;
+				arrays->weight[first_out[i] + j] = row[j].second;
 			}
+
+			arrays->component[i] = _component[order[i]];
 		}
+	});
+
+	std::span<const unsigned> head = arrays->head;
+	std::span<const unsigned> weight = arrays->weight;
+	std::span<const unsigned> component = arrays->component;
+	std::span<const unsigned> component_size = arrays->component_size;
+	std::span<const unsigned> first_out_span = first_out;
+
+	return Graph(std::move(arrays), first_out_span, head, weight, component, component_size, _directed);
+}
+
+NeighborRange Graph::get_neighbors(unsigned u) const noexcept
+{
+	return { _head.data() + _first_out[u], _weight.data() + _first_out[u], _first_out[u + 1] - _first_out[u] };
+}
+
+unsigned Graph::size() const noexcept
+{
+	return _first_out.size() - 1;
+}
+
+unsigned Graph::num_edges() const noexcept
+{
+	return _directed ? _head.size() : _head.size() / 2;
+}
+
+bool Graph::is_directed() const noexcept
+{
+	return _directed;
+}
+
+RoutingKit::ContractionHierarchy Graph::get_contraction_hierarchy() const
+{
+	std::vector<unsigned> tail(_head.size());
+
+	for (unsigned u = 0; u < size(); ++u)
+	{
+		std::fill(tail.begin() + _first_out[u], tail.begin() + _first_out[u + 1], u);
 	}
 
+	return RoutingKit::ContractionHierarchy::build(size(), tail, { _head.begin(), _head.end() }, { _weight.begin(), _weight.end() });
+}
+
+std::vector<Ball> Graph::get_balls(unsigned u) const
+{
+	std::vector<Ball> balls;
+	get_balls(u, balls);
+
 	return balls;
 }
 
-unsigned Graph::connected_component_size(unsigned u) const
+void Graph::get_balls(unsigned u, std::vector<Ball>& balls, const BallGrowth& growth) const
 {
-	std::vector<bool> visited(_neighbors.size(), false);
+	thread_local BallSearch search;
+	search.reset(size());
+
+	auto& [distance, epoch, current_epoch, queue] = search;
 
-	std::queue<unsigned> q;
-	q.push(u);
+	BallRecorder recorder(growth, balls);
 
-	unsigned visited_count = 0;
-	while (!q.empty())
+	distance[u] = 0;
+	epoch[u] = current_epoch;
+	queue.push(0, u);
+
+	while (!queue.empty())
 	{
-		unsigned node = q.front();
-		q.pop();
+		auto [node_distance, node] = queue.pop();
 
-		if (visited[node])
+		// only the entry of a node's final distance is current; every node is pushed at most once per distance
+		if (node_distance != distance[node])
+		{
 			continue;
+		}
 
-		visited[node] = true;
-		++visited_count;
+		if (node != u && !recorder.settle(node_distance))
+		{
+			break;
+		}
 
-		for (const auto& [neighbor, weight] : _neighbors[node])
+		for (const auto& [neighbor, weight] : get_neighbors(node))
 		{
-			if (!visited[neighbor])
+			unsigned new_distance = node_distance + weight;
+
+			if (epoch[neighbor] != current_epoch || new_distance < distance[neighbor])
 			{
-				q.push(neighbor);
+				epoch[neighbor] = current_epoch;
+				distance[neighbor] = new_distance;
+				queue.push(new_distance, neighbor);
 			}
 		}
 	}
 
-	return visited_count;
+	recorder.finish();
+}
+
+std::vector<Ball> Graph::balls_from_distances(std::vector<unsigned> distances, const BallGrowth& growth)
+{
+	std::sort(distances.begin(), distances.end());
+
+	// unreachable nodes sort last
+	while (!distances.empty() && distances.back() == RoutingKit::inf_weight)
+	{
+		distances.pop_back();
+	}
+
+	std::vector<Ball> balls;
+	BallRecorder recorder(growth, balls);
+
+	// the first distance is the source's own
+	for (unsigned i = 1; i < distances.size(); ++i)
+	{
+		if (!recorder.settle(distances[i]))
+		{
+			break;
+		}
+	}
+
+	recorder.finish();
+
+	return balls;
+}
+
+unsigned Graph::num_components() const noexcept
+{
+	return _component_size.size();
+}
+
+unsigned Graph::component(unsigned u) const noexcept
+{
+	return _component[u];
+}
+
+std::span<const unsigned> Graph::components() const noexcept
+{
+	return _component;
+}
+
+unsigned Graph::connected_component_size(unsigned u) const noexcept
+{
+	return _component_size[_component[u]];
 }
 
 // 10000.0 is the min distance
@@ -159,35 +779,28 @@ double Graph::tight_c(const std::vector<Ball>& balls, double alpha, unsigned num
 
 double Graph::minimize_tight_c(const std::vector<Ball>& balls, double guess, unsigned num_to_skip, unsigned min_distance, double tolerance)
 {
-	struct Params
-	{
-		const std::vector<Ball>* balls;
-		unsigned num_to_skip;
-		unsigned min_distance;
-	};
+	// filtered and logged once, rather than on every evaluation
+	BallProfile profile(balls, num_to_skip, min_distance);
 
 	auto tight_c_wrapper = [](double alpha, void* params) -> double {
-		Params* p = static_cast<Params*>(params);
-		return Graph::tight_c(*(p->balls), alpha, p->num_to_skip, p->min_distance);
+		return static_cast<const BallProfile*>(params)->tight_c(alpha);
 	};
 
-	Params params_struct = { &balls, num_to_skip, min_distance };
-
 	gsl_function F;
 	F.function = tight_c_wrapper;
-	F.params = &params_struct;
+	F.params = &profile;
 
 	const gsl_min_fminimizer_type* T = gsl_min_fminimizer_brent;
 	gsl_min_fminimizer* s = gsl_min_fminimizer_alloc(T);
 
-	double lower_bound = 0.001;
-	double upper_bound = 5.0;
+	double lower_bound = MIN_DIMENSION;
+	double upper_bound = MAX_DIMENSION;
 	double alpha_min = guess;
 
 	// the following avoids the case where the minimum is at the boundary
-	double l = F.function(lower_bound, &params_struct);
-	double u = F.function(upper_bound, &params_struct);
-	double m = F.function(alpha_min, &params_struct);
+	double l = profile.tight_c(lower_bound);
+	double u = profile.tight_c(upper_bound);
+	double m = profile.tight_c(alpha_min);
 
 	if (m > l || m > u)
 	{
@@ -216,7 +829,132 @@ double Graph::minimize_tight_c(const std::vector<Ball>& balls, double guess, uns
 	return alpha_min;
 }
 
-double Graph::estimate_optimal_dimension(double guess, unsigned num_to_skip, unsigned min_distance, double tolerance) const
+double Graph::minimize_tight_c_exactly(const std::vector<Ball>& balls, unsigned num_to_skip, unsigned min_distance)
+{
+	std::vector<Line> lines;
+	std::vector<Line> negated_lines;
+
+	for (const auto& ball : balls)
+	{
+		// a distance of 0 would make tight_c infinite for every alpha
+		if (ball.count <= num_to_skip || ball.distance < min_distance || ball.distance == 0)
+		{
+			continue;
+		}
+
+		double log_distance = std::log(ball.distance);
+		double log_count = std::log(ball.count);
+
+		lines.push_back({ -log_distance, log_count });
+		negated_lines.push_back({ log_distance, -log_count });
+	}
+
+	// the lower envelope is the negated upper envelope of the negated lines
+	std::vector<Line> upper, lower;
+	std::vector<double> upper_breakpoints, lower_breakpoints;
+	upper_envelope(std::move(lines), upper, upper_breakpoints);
+	upper_envelope(std::move(negated_lines), lower, lower_breakpoints);
+
+	if (upper_breakpoints.empty())
+	{
+		return -1.0;
+	}
+
+	// the gap is convex and piecewise linear, so it is smallest at a breakpoint of one of the envelopes
+	std::vector<double> candidates;
+	std::merge(upper_breakpoints.begin(), upper_breakpoints.end(), lower_breakpoints.begin(), lower_breakpoints.end(), std::back_inserter(candidates));
+
+	double best_alpha = candidates[0];
+	double best_gap = std::numeric_limits<double>::max();
+	unsigned upper_line = 0;
+	unsigned lower_line = 0;
+
+	for (double alpha : candidates)
+	{
+		while (upper_line < upper_breakpoints.size() && upper_breakpoints[upper_line] < alpha)
+		{
+			++upper_line;
+		}
+
+		while (lower_line < lower_breakpoints.size() && lower_breakpoints[lower_line] < alpha)
+		{
+			++lower_line;
+		}
+
+		double gap = upper[upper_line](alpha) + lower[lower_line](alpha);
+		if (gap < best_gap)
+		{
+			best_gap = gap;
+			best_alpha = alpha;
+		}
+	}
+
+	// a convex function's minimum over an interval is the clamped unconstrained one
+	return std::clamp(best_alpha, MIN_DIMENSION, MAX_DIMENSION);
+}
+
+double Graph::estimate_optimal_dimension(double guess, unsigned num_to_skip, unsigned min_distance, double tolerance, const PHAST* phast, TightCMinimizer minimizer, BallGrowth growth) const
+{
+	growth.num_to_skip = num_to_skip;
+	growth.min_distance = min_distance;
+
+	// every round gives each worker a source (with PHAST, enough sweeps of PHAST_LANES sources to do the same)
+	unsigned pool_size = ThreadPool::instance().size();
+	unsigned num_sweeps = phast == nullptr ? 0 : (pool_size + PHAST_LANES - 1) / PHAST_LANES;
+
+	// The sweeps, and the lane each worker copies out of them, are charged to the distance matrix budget until the
+	// estimate returns. Without room for them a round is a single sweep, and without room for that PHAST is not used.
+	DistanceMatrixReservation reservation;
+	auto sweep_bytes = [this, pool_size](unsigned sweeps) { return (size_t(sweeps) * PHAST_LANES + pool_size) * size() * sizeof(unsigned); };
+
+	if (phast != nullptr && !reservation.reserve(sweep_bytes(num_sweeps)))
+	{
+		num_sweeps = reservation.reserve(sweep_bytes(1)) ? 1 : 0;
+		phast = num_sweeps == 0 ? nullptr : phast;
+	}
+
+	unsigned round_size = phast == nullptr ? pool_size : num_sweeps * PHAST_LANES;
+
+	std::vector<unsigned> round_sources;
+	std::vector<std::vector<unsigned>> sweep_distances(num_sweeps);
+
+	auto prepare_round = [&](std::span<const unsigned> sources)
+	{
+		round_sources.assign(sources.begin(), sources.end());
+
+		ThreadPool::instance().parallel_for(num_sweeps, 1, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned sweep = first; sweep < last; ++sweep)
+			{
+				phast->run<PHAST_LANES>(std::span<const unsigned, PHAST_LANES>(round_sources.data() + sweep * PHAST_LANES, PHAST_LANES), sweep_distances[sweep]);
+			}
+		});
+	};
+
+	auto source_balls = [&](unsigned i, std::vector<Ball>& balls)
+	{
+		if (phast == nullptr)
+		{
+			get_balls(round_sources[i], balls, growth);
+			return;
+		}
+
+		const auto& distances = sweep_distances[i / PHAST_LANES];
+		unsigned lane = i % PHAST_LANES;
+
+		std::vector<unsigned> lane_distances(size());
+		for (unsigned rank = 0; rank < size(); ++rank)
+		{
+			lane_distances[rank] = distances[size_t(rank) * PHAST_LANES + lane];
+		}
+
+		balls = balls_from_distances(std::move(lane_distances), growth);
+	};
+
+	return estimate_dimension_in_rounds(size(), round_size, prepare_round, source_balls, guess, num_to_skip, min_distance, tolerance, minimizer);
+}
+
+double Graph::estimate_dimension_in_rounds(unsigned num_nodes, unsigned round_size, const std::function<void(std::span<const unsigned>)>& prepare_round, const std::function<void(unsigned, std::vector<Ball>&)>& source_balls, double guess, unsigned num_to_skip, unsigned min_distance, double tolerance, TightCMinimizer minimizer)
 {
 	double current_alpha = guess;
 	unsigned iteration = 0;
@@ -224,47 +962,67 @@ double Graph::estimate_optimal_dimension(double guess, unsigned num_to_skip, uns
 	double min_in_range = std::numeric_limits<double>::max();
 	double max_in_range = std::numeric_limits<double>::min();
 	std::mt19937 rng(std::random_device{}());
-	std::uniform_int_distribution<unsigned> dist(0, size() - 1);
-	std::vector<double> alpha_values;
+	std::uniform_int_distribution<unsigned> dist(0, num_nodes - 1);
+	RunningMedian alpha_values;
+
+	std::vector<unsigned> sources(round_size);
+	std::vector<double> round_alphas(round_size);
 
 	do
 	{
-		unsigned random_node = dist(rng);
-		auto balls = get_balls(random_node);
-
-		double alpha = minimize_tight_c(balls, current_alpha, num_to_skip, min_distance, tolerance);
-		if (alpha < 0.0)
+		for (unsigned& source : sources)
 		{
-			continue;
+			source = dist(rng);
 		}
-		
-		alpha_values.push_back(alpha);
 
-		std::vector<double> sorted_alpha_values = alpha_values;
-		std::sort(sorted_alpha_values.begin(), sorted_alpha_values.end());
-		size_t n = sorted_alpha_values.size();
-		if (n % 2 == 0)
-		{
-			current_alpha = (sorted_alpha_values[n / 2 - 1] + sorted_alpha_values[n / 2]) / 2.0;
-		}
-		else
+		prepare_round(sources);
+
+		// every source of the round starts from the same guess
+		ThreadPool::instance().parallel_for(round_size, 1, [&](unsigned first, unsigned last, unsigned)
 		{
-			current_alpha = sorted_alpha_values[n / 2];
-		}
+			thread_local std::vector<Ball> balls;
 
-		++iteration;
-		printf("Iteration: %d, Alpha: %f\n", iteration, current_alpha);
+			for (unsigned i = first; i < last; ++i)
+			{
+				source_balls(i, balls);
 
-		++iterations_since_last_change;
-		min_in_range = std::min(min_in_range, current_alpha);
-		max_in_range = std::max(max_in_range, current_alpha);
+				round_alphas[i] = minimizer == TightCMinimizer::CONVEX_HULL
+					? minimize_tight_c_exactly(balls, num_to_skip, min_distance)
+					: minimize_tight_c(balls, current_alpha, num_to_skip, min_distance, tolerance);
+			}
+		});
 
-		if (max_in_range - min_in_range > tolerance)
+		// the convergence rule sees the round's estimates one at a time, in order, as if they had been computed one by one
+		for (double alpha : round_alphas)
 		{
-			iterations_since_last_change = 0;
-			min_in_range = max_in_range = current_alpha;
+			if (alpha < 0.0)
+			{
+				continue;
+			}
+
+			alpha_values.add(alpha);
+			current_alpha = alpha_values.median();
+
+			++iteration;
+			++iterations_since_last_change;
+			min_in_range = std::min(min_in_range, current_alpha);
+			max_in_range = std::max(max_in_range, current_alpha);
+
+			if (max_in_range - min_in_range > tolerance)
+			{
+				iterations_since_last_change = 0;
+				min_in_range = max_in_range = current_alpha;
+			}
+
+			if (iterations_since_last_change >= 100u)
+			{
+				break;
+			}
 		}
+
+		printf("Iteration: %d, Alpha: %f\n", iteration, current_alpha);
 	} while (iterations_since_last_change < 100u);
 
 	return current_alpha;
 }
+
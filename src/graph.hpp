@@ -1,7 +1,15 @@
 #pragma once
 
+#include "phast.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <routingkit/contraction_hierarchy.h>
@@ -12,31 +20,211 @@ struct Ball
 	unsigned count;
 };
 
-class Graph
+// How far a ball growth goes and which balls it records. The defaults grow the whole component and record every ball.
+struct BallGrowth
+{
+	// stop before settling a node farther than max_distance, or once max_count nodes besides the source are settled
+	unsigned max_distance = std::numeric_limits<unsigned>::max();
+	unsigned max_count = std::numeric_limits<unsigned>::max();
+
+	// only the balls tight_c would look at are recorded
+	unsigned num_to_skip = 0;
+	unsigned min_distance = 0;
+
+	// log-spaced sampling: a ball is only recorded once its count is at least growth_factor times the last recorded
+	// one (the last ball is always recorded); 1 records every ball
+	double growth_factor = 1.0;
+};
+
+// The arcs leaving one node of a Graph. Iterating yields (neighbor, weight) pairs;
+// targets() and weights() expose the underlying arrays.
+class NeighborRange
 {
 public:
-	Graph(unsigned num_nodes, bool directed = false);
+	class Iterator
+	{
+	public:
+		Iterator(const unsigned* target, const unsigned* weight) noexcept :
+			_target(target), _weight(weight)
+		{
+		}
+
+		std::pair<unsigned, unsigned> operator*() const noexcept
+		{
+			return { *_target, *_weight };
+		}
+
+		Iterator& operator++() noexcept
+		{
+			++_target;
+			++_weight;
+			return *this;
+		}
+
+		bool operator!=(const Iterator& other) const noexcept
+		{
+			return _target != other._target;
+		}
+
+	private:
+		const unsigned* _target;
+		const unsigned* _weight;
+	};
+
+	NeighborRange(const unsigned* targets, const unsigned* weights, unsigned size) noexcept :
+		_targets(targets), _weights(weights), _size(size)
+	{
+	}
+
+	Iterator begin() const noexcept
+	{
+		return { _targets, _weights };
+	}
+
+	Iterator end() const noexcept
+	{
+		return { _targets + _size, _weights + _size };
+	}
 
+	unsigned size() const noexcept
+	{
+		return _size;
+	}
+
+	std::span<const unsigned> targets() const noexcept
+	{
+		return { _targets, _size };
+	}
+
+	std::span<const unsigned> weights() const noexcept
+	{
+		return { _weights, _size };
+	}
+
+private:
+	const unsigned* _targets;
+	const unsigned* _weights;
+	unsigned _size;
+};
+
+// Collects the edges of a Graph in any order. Parallel edges are allowed; the Graph keeps the lightest.
+class GraphBuilder
+{
+public:
+	GraphBuilder(unsigned num_nodes, bool directed = false);
+
+	// undirected builders add the arc in both directions
 	void add_edge(unsigned u, unsigned v, unsigned weight);
 
-	const std::unordered_map<unsigned, unsigned>& get_neighbors(unsigned u) const;
+	// moves the arcs of another builder over the same nodes into this one
+	void append(GraphBuilder&& other);
+
+	unsigned size() const noexcept;
+
+private:
+	friend class Graph;
+
+	unsigned _num_nodes;
+	bool _directed;
+
+	std::vector<unsigned> _tails;
+	std::vector<unsigned> _heads;
+	std::vector<unsigned> _weights;
+};
+
+// the range of dimensions minimize_tight_c searches
+static const double MIN_DIMENSION = 0.001;
+static const double MAX_DIMENSION = 5.0;
+
+enum class TightCMinimizer
+{
+	BRENT,      // GSL's Brent iterations from a guess; gives up with -1 if the minimum looks like it is at a boundary
+	CONVEX_HULL // exact: log(tight_c) is the gap between the upper and lower envelopes of one line per ball
+};
+
+// bumped whenever the layout of graph files changes; files of other versions are rejected
+static const unsigned GRAPH_FILE_VERSION = 3;
+
+// Immutable graph in compressed sparse row form: the arcs of node u are
+// _head[_first_out[u], _first_out[u + 1]) with weights in _weight, sorted by head.
+class Graph
+{
+public:
+	// sorts the builder's arcs into rows and drops parallel arcs, in parallel on the thread pool
+	explicit Graph(GraphBuilder&& builder);
+
+	// Maps a file written by save_file and views its arrays in place, without parsing or copying.
+	// Empty if the file is missing, truncated, or of another GRAPH_FILE_VERSION.
+	static std::optional<Graph> load_file(const std::string& path);
+
+	// a header (magic, version, directedness, node, arc and component counts) followed by the first_out, head and
+	// weight arrays, the component of every node and the size of every component
+	void save_file(const std::string& path) const;
+
+	// a 64-bit hash of the node count, directedness and arcs, so that caches derived from a graph can tell when it changed
+	uint64_t content_hash() const;
+
+	// the same graph with node order[i] as node i (see node_order.hpp); components keep their numbers
+	Graph renumbered(std::span<const unsigned> order) const;
+
+	NeighborRange get_neighbors(unsigned u) const noexcept;
 	unsigned size() const noexcept;
 	unsigned num_edges() const noexcept;
+	bool is_directed() const noexcept;
 
 	RoutingKit::ContractionHierarchy get_contraction_hierarchy() const;
 
 	std::vector<Ball> get_balls(unsigned u) const;
 
-	unsigned connected_component_size(unsigned u) const;
+	// Writes the balls of u into balls, replacing its contents. A radix-heap Dijkstra over a thread_local,
+	// epoch-stamped workspace, so repeated calls with the same buffer allocate nothing once it has grown.
+	// A bounded growth settles and stores only what it needs, so its cost no longer scales with the component.
+	void get_balls(unsigned u, std::vector<Ball>& balls, const BallGrowth& growth = {}) const;
+
+	// the balls of a source given its one-to-all distances (including its own distance of 0)
+	static std::vector<Ball> balls_from_distances(std::vector<unsigned> distances, const BallGrowth& growth = {});
+
+	// Components are labeled once, when the graph is built, and numbered by decreasing size: component 0 is the
+	// largest. Those of a directed graph are its strongly connected ones, so every node of a component reaches every
+	// other in either kind of graph.
+	unsigned num_components() const noexcept;
+
+	unsigned component(unsigned u) const noexcept;
+
+	// the component of every node
+	std::span<const unsigned> components() const noexcept;
+
+	unsigned connected_component_size(unsigned u) const noexcept;
 
 	static double tight_c(const std::vector<Ball>& balls, double alpha, unsigned num_to_skip = 0, unsigned min_distance = 0);
 
 	static double minimize_tight_c(const std::vector<Ball>& balls, double guess, unsigned num_to_skip = 0, unsigned min_distance = 0, double fractional_difference = 5e-4);
 
-	double estimate_optimal_dimension(double guess = 1.5, unsigned num_to_skip = 0, unsigned min_distance = 0, double tolerance = 2e-3) const;
+	// The exact minimizer of tight_c over [MIN_DIMENSION, MAX_DIMENSION] in O(n log n), with no guess or iterations.
+	// log(count) - alpha * log(distance) is a line in alpha for each ball, and log(tight_c(alpha)) is the gap between
+	// the upper and lower envelopes of those lines, a convex piecewise linear function minimized at a breakpoint.
+	// -1 if fewer than two distinct distances remain after skipping.
+	static double minimize_tight_c_exactly(const std::vector<Ball>& balls, unsigned num_to_skip = 0, unsigned min_distance = 0);
+
+	// with a PHAST engine over this graph's contraction hierarchy, the balls of 16 sources come from one sweep
+	// growth bounds the balls of every source; its num_to_skip and min_distance are taken from the arguments
+	double estimate_optimal_dimension(double guess = 1.5, unsigned num_to_skip = 0, unsigned min_distance = 0, double tolerance = 2e-3, const PHAST* phast = nullptr, TightCMinimizer minimizer = TightCMinimizer::BRENT, BallGrowth growth = {}) const;
+
+	// The rounds and convergence rule of estimate_optimal_dimension, for any way of growing balls. Every round draws
+	// round_size sources from [0, num_nodes) and hands them to prepare_round; source_balls(i, balls) then gives the
+	// balls of the i-th, concurrently for different i, and the median of their tight_c minimizers is tracked.
+	static double estimate_dimension_in_rounds(unsigned num_nodes, unsigned round_size, const std::function<void(std::span<const unsigned>)>& prepare_round, const std::function<void(unsigned, std::vector<Ball>&)>& source_balls, double guess, unsigned num_to_skip, unsigned min_distance, double tolerance, TightCMinimizer minimizer);
 
 private:
-	std::vector<std::unordered_map<unsigned, unsigned>> _neighbors;
+	Graph(std::shared_ptr<const void> storage, std::span<const unsigned> first_out, std::span<const unsigned> head, std::span<const unsigned> weight, std::span<const unsigned> component, std::span<const unsigned> component_size, bool directed) noexcept;
+
+	// owns the arrays, whether built in memory or mapped from a file; copies of a Graph share it
+	std::shared_ptr<const void> _storage;
+
+	std::span<const unsigned> _first_out;
+	std::span<const unsigned> _head;
+	std::span<const unsigned> _weight;
+	std::span<const unsigned> _component;
+	std::span<const unsigned> _component_size;
 	bool _directed;
-	unsigned _num_edges;
 };
\ No newline at end of file
@@ -1,225 +1,758 @@
 #include "highway.hpp"
 
+#include "alias_sampler.hpp"
 #include "data.hpp"
+#include "thread_local_query.hpp"
+#include "thread_pool.hpp"
 
+#include <routingkit/constants.h>
 #include <routingkit/contraction_hierarchy.h>
 
-#include <future>
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <random>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_math.h>
 #include <gsl/gsl_min.h>
 
-Highway::Highway(const std::string& name, const RoutingKit::ContractionHierarchy& ch, unsigned k, unsigned Q, double clustering_exponent) :
-	_name(name), _contraction_hierarchy(ch), _k(k), _Q(Q), _clustering_exponent(clustering_exponent), _num_nodes(ch.node_count())
+namespace
 {
+	template <typename Oracle, typename DistanceToEnd, typename NextHop>
+	unsigned route_greedily(const Highway<Oracle>& highway, unsigned exponent_index, unsigned start, unsigned end, Philox& rng, DistanceToEnd&& distance_to_end, NextHop&& next_hop) noexcept
+	{
+		unsigned path_length = 0;
+		unsigned closest_distance = std::numeric_limits<unsigned>::max();
+
+		while (start != end)
+		{
+			++path_length;
+
+			unsigned min_distance = std::numeric_limits<unsigned>::max();
+			unsigned min_node = 0;
+
+			highway.for_each_long_distance_contact(start, exponent_index, rng, [&](unsigned contact)
+			{
+				unsigned distance = distance_to_end(contact);
+				if (distance < min_distance)
+				{
+					min_distance = distance;
+					min_node = contact;
+				}
+			});
+
+			unsigned local_contact = next_hop(start);
+			unsigned local_distance = distance_to_end(local_contact);
+
+			// A contact must also be closer than any node visited so far. Road distances shrink with every hop, so
+			// this changes nothing for them, but geometric ones need not, and frozen contacts could then loop forever.
+			if (min_distance < local_distance && min_distance < closest_distance)
+			{
+				// take a long distance contact
+				start = min_node;
+				closest_distance = min_distance;
+				continue;
+			}
+
+			// take a local contact
+			start = local_contact;
+			closest_distance = std::min(closest_distance, local_distance);
+		}
+
+		return path_length;
+	}
+
+	struct BoundedContact
+	{
+		unsigned node;
+		unsigned lower_bound;
+		unsigned upper_bound;
+	};
+
+	// route_greedily by road distance, with the contacts' distances to end bounded by landmarks before any is queried.
+	// A contact is dropped if its lower bound shows it cannot beat the local contact, or some other contact for sure;
+	// if a single contact remains and its upper bound already beats the local contact, it is taken unqueried. The
+	// path is the same as route_greedily's. Adds the contact distance queries avoided to avoided_queries.
+	template <typename Oracle, typename DistanceToEnd, typename NextHop>
+	unsigned route_greedily_with_landmarks(const Highway<Oracle>& highway, const Landmarks& landmarks, unsigned exponent_index, unsigned start, unsigned end, Philox& rng, DistanceToEnd&& distance_to_end, NextHop&& next_hop, uint64_t& avoided_queries) noexcept
+	{
+		thread_local std::vector<BoundedContact> contacts;
+
+		unsigned path_length = 0;
+		unsigned closest_distance = std::numeric_limits<unsigned>::max();
+
+		while (start != end)
+		{
+			++path_length;
+
+			// the local contact comes first here, since it decides which contacts are worth a query
+			unsigned local_contact = next_hop(start);
+			unsigned local_distance = distance_to_end(local_contact);
+
+			unsigned threshold = std::min(local_distance, closest_distance);
+			unsigned min_upper_bound = std::numeric_limits<unsigned>::max();
+
+			contacts.clear();
+			highway.for_each_long_distance_contact(start, exponent_index, rng, [&](unsigned contact)
+			{
+				auto [lower_bound, upper_bound] = landmarks.bounds(contact, end);
+				contacts.push_back({ contact, lower_bound, upper_bound });
+				min_upper_bound = std::min(min_upper_bound, upper_bound);
+			});
+
+			unsigned num_contacts = contacts.size();
+
+			// a contact whose lower bound exceeds another's upper bound is strictly farther, so ties keep their order
+			std::erase_if(contacts, [&](const BoundedContact& contact)
+			{
+				return contact.lower_bound >= threshold || contact.lower_bound > min_upper_bound;
+			});
+
+			unsigned min_distance = std::numeric_limits<unsigned>::max();
+			unsigned min_node = 0;
+
+			bool single_node = !contacts.empty() && std::all_of(contacts.begin(), contacts.end(), [&](const BoundedContact& contact) { return contact.node == contacts[0].node; });
+
+			if (single_node && contacts[0].upper_bound < threshold)
+			{
+				// Certified without a query. closest_distance then holds an upper bound, which is harmless: road
+				// distances shrink with every hop, so the closest_distance rule never decides anything for them.
+				min_distance = contacts[0].upper_bound;
+				min_node = contacts[0].node;
+				avoided_queries += num_contacts;
+			}
+			else
+			{
+				avoided_queries += num_contacts - contacts.size();
+
+				for (const auto& contact : contacts)
+				{
+					unsigned distance = distance_to_end(contact.node);
+					if (distance < min_distance)
+					{
+						min_distance = distance;
+						min_node = contact.node;
+					}
+				}
+			}
+
+			if (min_distance < threshold)
+			{
+				// take a long distance contact
+				start = min_node;
+				closest_distance = min_distance;
+				continue;
+			}
+
+			// take a local contact
+			start = local_contact;
+			closest_distance = std::min(closest_distance, local_distance);
+		}
+
+		return path_length;
+	}
+}
+
+template <DistanceOracle Oracle>
+Highway<Oracle>::Highway(const std::string& name, Oracle oracle, unsigned k, unsigned Q, double clustering_exponent, const HighwayOptions& options) :
+	Highway(name, std::move(oracle), k, Q, std::vector<double>{ clustering_exponent }, options)
+{
+}
+
+template <DistanceOracle Oracle>
+Highway<Oracle>::Highway(const std::string& name, Oracle oracle, unsigned k, unsigned Q, const std::vector<double>& clustering_exponents, const HighwayOptions& options) :
+	_name(name), _oracle(std::move(oracle)), _k(k), _Q(Q), _clustering_exponents(clustering_exponents), _options(options),
+	_num_nodes(_oracle.size()), _distance_matrix(_oracle)
+{
+	if constexpr (USES_CONTRACTION_HIERARCHY)
+	{
+		const auto& ch = _oracle.contraction_hierarchy();
+
+		// every worker sweeps into its own buffer of one distance per node and lane, charged to the shared budget;
+		// with no room for PHAST_LANES lanes, half as many are tried before falling back to reverse trees
+		if (_options.greedy_routing == GreedyRouting::PHAST)
+		{
+			size_t lane_bytes = size_t(ThreadPool::instance().size()) * _num_nodes * sizeof(unsigned);
+
+			for (unsigned lanes : { PHAST_LANES, PHAST_LANES / 2 })
+			{
+				if (_phast_reservation.reserve(lanes * lane_bytes))
+				{
+					_phast_lanes = lanes;
+					break;
+				}
+			}
+
+			if (_phast_lanes == 0)
+			{
+				printf("%s has no room in the memory budget for PHAST sweeps, routing over reverse trees\n", _name.c_str());
+				_options.greedy_routing = GreedyRouting::REVERSE_TREE;
+			}
+		}
+
+		if (_options.greedy_routing == GreedyRouting::REVERSE_TREE)
+		{
+			_reverse_graph.emplace(ch, true);
+		}
+
+		if (_options.greedy_routing == GreedyRouting::PHAST)
+		{
+			_forward_graph.emplace(ch, false);
+			_phast.emplace(ch, PHAST::Direction::TO_TARGETS);
+			_phast_distances.resize(ThreadPool::instance().size());
+		}
+	}
+
+	if (_options.seed == 0)
+	{
+		std::random_device random_device;
+		_options.seed = (uint64_t(random_device()) << 32) | random_device();
+	}
+
+	if (_options.greedy_metric != GreedyMetric::ROAD_DISTANCE && _options.coordinates.size() != _num_nodes)
+	{
+		printf("%s has no coordinates for its %u nodes, routing by road distance\n", _name.c_str(), _num_nodes);
+		_options.greedy_metric = GreedyMetric::ROAD_DISTANCE;
+	}
+
+	if (!_options.components.empty())
+	{
+		if (_options.components.size() != _num_nodes)
+		{
+			printf("%s has no components for its %u nodes, drawing trials from all of them\n", _name.c_str(), _num_nodes);
+		}
+		else
+		{
+			for (unsigned node = 0; node < _num_nodes; ++node)
+			{
+				if (_options.components[node] == 0)
+				{
+					_trial_nodes.push_back(node);
+				}
+			}
+		}
+	}
+
 	_is_highway_node.resize(_num_nodes, false);
+	_highway_index.resize(_num_nodes, std::numeric_limits<unsigned>::max());
 }
 
-const std::string& Highway::name() const noexcept
+template <DistanceOracle Oracle>
+const std::string& Highway<Oracle>::name() const noexcept
 {
 	return _name;
 }
 
-void Highway::initialize() noexcept
+template <DistanceOracle Oracle>
+const std::vector<double>& Highway<Oracle>::clustering_exponents() const noexcept
 {
-	static std::mt19937 rng(std::random_device{}());
-	static std::uniform_real_distribution<double> dist(0.0, 1.0);
+	return _clustering_exponents;
+}
+
+template <DistanceOracle Oracle>
+void Highway<Oracle>::initialize() noexcept
+{
+	std::uniform_real_distribution<double> dist(0.0, 1.0);
+
+	++_batch;
 
 	_highway_nodes.clear();
 	_highway_nodes.reserve(_num_nodes / _k * 2);
 
 	for (unsigned node = 0; node < _num_nodes; ++node)
 	{
+		Philox rng(_options.seed, RandomStream::HIGHWAY_NODES, _batch, node);
+
 		if (dist(rng) < (1.0 / _k))
 		{
+			_highway_index[node] = _highway_nodes.size();
 			_highway_nodes.push_back(node);
 			_is_highway_node[node] = true;
 			continue;
 		}
 
+		_highway_index[node] = std::numeric_limits<unsigned>::max();
 		_is_highway_node[node] = false;
 	}
+
+	_distance_matrix.build(_highway_nodes);
+
+	_landmark_hops = 0;
+	_avoided_queries = 0;
+	_failed_trials = 0;
+
+	if (_options.contact_sampling == ContactSampling::FROZEN)
+	{
+		freeze_long_distance_contacts();
+	}
 }
 
-void Highway::for_each_long_distance_contact(unsigned u, const std::function<void(unsigned)>& callback) const noexcept
+template <DistanceOracle Oracle>
+void Highway<Oracle>::freeze_long_distance_contacts() noexcept
 {
-	if (!_is_highway_node[u])
+	size_t num_contacts = _k * _Q;
+	size_t num_highway_nodes = _highway_nodes.size();
+	_frozen_contacts.resize(_clustering_exponents.size() * num_highway_nodes * num_contacts);
+
+	ThreadPool::instance().parallel_for(num_highway_nodes, 64, [this, num_contacts, num_highway_nodes](unsigned first, unsigned last, unsigned)
 	{
-		return;
+		thread_local std::vector<unsigned> row_buffer;
+		thread_local std::vector<double> log_distances;
+		thread_local std::vector<double> weights;
+		thread_local AliasSampler sampler;
+
+		for (unsigned j = first; j < last; ++j)
+		{
+			// the row and its logarithms are shared by every exponent
+			compute_log_distances(_distance_matrix.get_row(j, row_buffer), log_distances);
+
+			for (unsigned e = 0; e < _clustering_exponents.size(); ++e)
+			{
+				compute_power_law_weights(log_distances, _clustering_exponents[e], weights);
+				weights[j] = 0.0;
+
+				sampler.build(weights);
+
+				// every exponent replays the same random numbers
+				Philox rng(_options.seed, RandomStream::FROZEN_CONTACTS, _batch, _highway_nodes[j]);
+				unsigned* contacts = _frozen_contacts.data() + (e * num_highway_nodes + j) * num_contacts;
+
+				for (unsigned i = 0; i < num_contacts; ++i)
+				{
+					contacts[i] = _highway_nodes[sampler(rng)];
+				}
+			}
+		}
+	});
+}
+
+template <DistanceOracle Oracle>
+std::span<const unsigned> Highway<Oracle>::get_frozen_contacts(unsigned u, unsigned exponent_index) const noexcept
+{
+	if (!_is_highway_node[u] || _options.contact_sampling != ContactSampling::FROZEN)
+	{
+		return {};
 	}
 
-	thread_local std::mt19937 rng(std::random_device{}());
-	thread_local RoutingKit::ContractionHierarchyQuery ch_query(_contraction_hierarchy);
+	size_t num_contacts = _k * _Q;
+	size_t offset = (size_t(exponent_index) * _highway_nodes.size() + _highway_index[u]) * num_contacts;
 
-	auto distances = ch_query.reset().add_source(u).pin_targets(_highway_nodes).run_to_pinned_targets().get_distances_to_targets();
+	return { _frozen_contacts.data() + offset, num_contacts };
+}
 
-	std::vector<double> probabilities;
+template <DistanceOracle Oracle>
+void Highway<Oracle>::for_each_long_distance_contact(unsigned u, Philox& rng, const std::function<void(unsigned)>& callback) const noexcept
+{
+	for_each_long_distance_contact(u, 0, rng, callback);
+}
 
-	for (unsigned i = 0; i < _highway_nodes.size(); ++i)
+template <DistanceOracle Oracle>
+void Highway<Oracle>::for_each_long_distance_contact(unsigned u, unsigned exponent_index, Philox& rng, const std::function<void(unsigned)>& callback) const noexcept
+{
+	if (!_is_highway_node[u])
+	{
+		return;
+	}
+
+	if (_options.contact_sampling == ContactSampling::FROZEN)
 	{
-		unsigned node = _highway_nodes[i];
-		if (node == u)
+		for (unsigned contact : get_frozen_contacts(u, exponent_index))
 		{
-			probabilities.push_back(0.0);
-			continue;
+			callback(contact);
 		}
 
-		unsigned distance = distances[i];
-		double probability = std::pow(distance, -_clustering_exponent);
-		probabilities.push_back(probability);
+		return;
 	}
 
-	std::discrete_distribution<unsigned> dist(probabilities.begin(), probabilities.end());
-	
+	sample_long_distance_contacts(u, exponent_index, rng, callback);
+}
+
+template <DistanceOracle Oracle>
+void Highway<Oracle>::sample_long_distance_contacts(unsigned u, unsigned exponent_index, Philox& rng, const std::function<void(unsigned)>& callback) const noexcept
+{
+	thread_local std::vector<unsigned> row_buffer;
+	thread_local std::vector<double> weights;
+	thread_local AliasSampler sampler;
+
+	auto distances = _distance_matrix.get_row(_highway_index[u], row_buffer);
+
+	compute_power_law_weights(distances, _clustering_exponents[exponent_index], weights);
+	weights[_highway_index[u]] = 0.0;
+
+	sampler.build(weights);
+
 	for (unsigned i = 0; i < _k * _Q; ++i)
 	{
-		callback(_highway_nodes[dist(rng)]);
+		callback(_highway_nodes[sampler(rng)]);
+	}
+}
+
+template <DistanceOracle Oracle>
+unsigned Highway<Oracle>::get_distance(unsigned s, unsigned t) const noexcept
+{
+	return _oracle.distance(s, t);
+}
+
+template <DistanceOracle Oracle>
+template <typename RoadDistanceToEnd, typename NextHop>
+unsigned Highway<Oracle>::route_greedily(unsigned exponent_index, unsigned start, unsigned end, Philox& rng, RoadDistanceToEnd&& road_distance_to_end, NextHop&& next_hop) const noexcept
+{
+	// a contact that cannot reach end is never taken, however close it is in coordinates: routing would be stuck there
+	switch (_options.greedy_metric)
+	{
+	case GreedyMetric::EUCLIDEAN:
+		return ::route_greedily(*this, exponent_index, start, end, rng, [&](unsigned node)
+		{
+			return road_distance_to_end(node) == RoutingKit::inf_weight ? RoutingKit::inf_weight : euclidean_distance(_options.coordinates[node], _options.coordinates[end]);
+		}, next_hop);
+
+	case GreedyMetric::GREAT_CIRCLE:
+		return ::route_greedily(*this, exponent_index, start, end, rng, [&](unsigned node)
+		{
+			return road_distance_to_end(node) == RoutingKit::inf_weight ? RoutingKit::inf_weight : great_circle_distance(_options.coordinates[node], _options.coordinates[end]);
+		}, next_hop);
+
+	default:
+		return ::route_greedily(*this, exponent_index, start, end, rng, road_distance_to_end, next_hop);
 	}
 }
 
-unsigned Highway::get_distance(unsigned s, unsigned t) const noexcept
+template <DistanceOracle Oracle>
+unsigned Highway<Oracle>::get_greedy_path_length(unsigned start, unsigned end, unsigned trial) const noexcept
 {
-	thread_local RoutingKit::ContractionHierarchyQuery ch_query(_contraction_hierarchy);
-	return ch_query.reset().add_source(s).add_target(t).run().get_distance();
+	std::array<double, 1> path_length = { 0.0 };
+	add_greedy_path_lengths(start, end, trial, path_length);
+
+	return path_length[0];
 }
 
-unsigned Highway::get_greedy_path_length(unsigned start, unsigned end) const noexcept
+template <DistanceOracle Oracle>
+void Highway<Oracle>::add_greedy_path_lengths(unsigned start, unsigned end, unsigned trial, std::span<double> path_lengths) const noexcept
 {
-	thread_local RoutingKit::ContractionHierarchyQuery ch_query(_contraction_hierarchy);
-	
-	ch_query.reset_target().add_target(end);
+	if constexpr (!USES_CONTRACTION_HIERARCHY)
+	{
+		if (_oracle.distance(start, end) == RoutingKit::inf_weight)
+		{
+			++_failed_trials;
+			return;
+		}
 
-	unsigned path_length = 0;
+		// distances and next hops are cheap enough to ask the oracle for at every hop
+		for (unsigned e = 0; e < path_lengths.size(); ++e)
+		{
+			Philox rng(_options.seed, RandomStream::RESAMPLED_CONTACTS, _batch, trial);
 
-	while (start != end)
+			path_lengths[e] += route_greedily(e, start, end, rng,
+				[this, end](unsigned node) { return _oracle.distance(node, end); },
+				[this, end](unsigned node) { return _oracle.next_hop(node, end); });
+		}
+	}
+	else if (_options.greedy_routing == GreedyRouting::PHAST)
 	{
-		++path_length;
+		std::vector<unsigned> distances;
+		std::array<unsigned, 1> ends = { end };
 
-		unsigned min_distance = std::numeric_limits<unsigned>::max();
-		unsigned min_node = 0;
+		_phast->run<1>(ends, distances);
+
+		add_greedy_path_lengths(start, end, trial, distances, 1, 0, path_lengths);
+	}
+	else if (_options.greedy_routing == GreedyRouting::REVERSE_TREE)
+	{
+		// Road distances never leave the ball around end through start, but geometric ones may pick a contact outside
+		// it, so they need the whole tree
+		thread_local ShortestPathTree tree;
+		tree.grow(*_reverse_graph, end, _options.greedy_metric == GreedyMetric::ROAD_DISTANCE ? start : RoutingKit::invalid_id);
+
+		if (tree.distance(start) == RoutingKit::inf_weight)
+		{
+			++_failed_trials;
+			return;
+		}
 
-		for_each_long_distance_contact(start, [&](unsigned contact)
+		for (unsigned e = 0; e < path_lengths.size(); ++e)
 		{
-			unsigned distance = get_distance(contact, end);
-			if (distance < min_distance)
+			// every exponent replays the same random numbers
+			Philox rng(_options.seed, RandomStream::RESAMPLED_CONTACTS, _batch, trial);
+
+			path_lengths[e] += route_greedily(e, start, end, rng,
+				[](unsigned node) { return tree.distance(node); },
+				[](unsigned node) { return tree.next_hop(node); });
+		}
+	}
+	else
+	{
+		if (get_distance(start, end) == RoutingKit::inf_weight)
+		{
+			++_failed_trials;
+			return;
+		}
+
+		auto& ch_query = get_thread_local_query<1>(_oracle.contraction_hierarchy());
+
+		ch_query.reset_target().add_target(end);
+
+		auto distance_to_end = [this, end](unsigned node) { return get_distance(node, end); };
+		auto next_hop = [&ch_query](unsigned node) { return ch_query.reset_source().add_source(node).run().get_node_path()[1]; };
+
+		bool use_landmarks = _options.landmarks != nullptr && _options.greedy_metric == GreedyMetric::ROAD_DISTANCE;
+		uint64_t hops = 0;
+		uint64_t avoided_queries = 0;
+
+		for (unsigned e = 0; e < path_lengths.size(); ++e)
+		{
+			Philox rng(_options.seed, RandomStream::RESAMPLED_CONTACTS, _batch, trial);
+
+			if (use_landmarks)
 			{
-				min_distance = distance;
-				min_node = contact;
+				unsigned path_length = ::route_greedily_with_landmarks(*this, *_options.landmarks, e, start, end, rng, distance_to_end, next_hop, avoided_queries);
+				path_lengths[e] += path_length;
+				hops += path_length;
+				continue;
 			}
-		});
 
-		unsigned local_contact = ch_query.reset_source().add_source(start).run().get_node_path()[1];
-		unsigned local_distance = get_distance(local_contact, end);
+			path_lengths[e] += route_greedily(e, start, end, rng, distance_to_end, next_hop);
+		}
 
-		if (min_distance < local_distance)
+		if (use_landmarks)
 		{
-			// take a long distance contact
-			start = min_node;
-			continue;
+			_landmark_hops += hops;
+			_avoided_queries += avoided_queries;
 		}
+	}
+}
 
-		// take a local contact
-		start = local_contact;
+template <DistanceOracle Oracle>
+void Highway<Oracle>::add_greedy_path_lengths(unsigned start, unsigned end, unsigned trial, const std::vector<unsigned>& distances, unsigned num_lanes, unsigned lane, std::span<double> path_lengths) const noexcept
+{
+	auto distance_to_end = [&](unsigned node)
+	{
+		return distances[size_t(_phast->rank(node)) * num_lanes + lane];
+	};
+
+	auto next_hop = [&](unsigned node)
+	{
+		unsigned min_distance = std::numeric_limits<unsigned>::max();
+		unsigned min_node = node;
+
+		for (unsigned arc = _forward_graph->first_arc[node]; arc < _forward_graph->first_arc[node + 1]; ++arc)
+		{
+			unsigned head = _forward_graph->other_end[arc];
+			unsigned distance = distance_to_end(head);
+
+			if (distance != RoutingKit::inf_weight && distance + _forward_graph->weight[arc] < min_distance)
+			{
+				min_distance = distance + _forward_graph->weight[arc];
+				min_node = head;
+			}
+		}
+
+		return min_node;
+	};
+
+	if (distance_to_end(start) == RoutingKit::inf_weight)
+	{
+		++_failed_trials;
+		return;
 	}
 
-	return path_length;
+	for (unsigned e = 0; e < path_lengths.size(); ++e)
+	{
+		Philox rng(_options.seed, RandomStream::RESAMPLED_CONTACTS, _batch, trial);
+
+		path_lengths[e] += route_greedily(e, start, end, rng, distance_to_end, next_hop);
+	}
+}
+
+template <DistanceOracle Oracle>
+double Highway<Oracle>::get_total_greedy_path_length(unsigned num_trials) const noexcept
+{
+	return get_total_greedy_path_lengths(num_trials)[0];
 }
 
-double Highway::get_total_greedy_path_length(unsigned num_trials) const noexcept
+template <DistanceOracle Oracle>
+std::vector<double> Highway<Oracle>::get_total_greedy_path_lengths(unsigned num_trials) const noexcept
 {
-	double total_path_length = 0.0;
+	auto& pool = ThreadPool::instance();
+	unsigned num_exponents = _clustering_exponents.size();
 
-	std::vector<std::future<double>> futures;
+	// worker w adds into worker_totals[w * num_exponents, (w + 1) * num_exponents)
+	std::vector<double> worker_totals(pool.size() * num_exponents, 0.0);
 
-	for (unsigned i = 0; i < NUM_THREADS; ++i)
+	// path lengths vary a lot between trials, so hand them out in small chunks that idle workers can steal
+	unsigned chunk_size = _phast ? _phast_lanes : TRIAL_CHUNK_SIZE;
+
+	pool.parallel_for(num_trials, chunk_size, [this, &worker_totals, num_exponents](unsigned first, unsigned last, unsigned worker) noexcept
 	{
-		futures.emplace_back(std::async(std::launch::async, [this, num_trials, i]() noexcept
+		std::uniform_int_distribution<unsigned> dist(0, (_trial_nodes.empty() ? _num_nodes : _trial_nodes.size()) - 1);
+
+		auto draw_endpoint = [this, &dist](Philox& rng)
 		{
-			thread_local std::mt19937 rng(std::random_device{}());
-			thread_local std::uniform_int_distribution<unsigned> dist(0, _num_nodes - 1);
+			unsigned i = dist(rng);
+			return _trial_nodes.empty() ? i : _trial_nodes[i];
+		};
 
-			double local_total_path_length = 0.0;
+		std::span<double> totals(worker_totals.data() + size_t(worker) * num_exponents, num_exponents);
 
-			for (unsigned j = i; j < num_trials; j += NUM_THREADS)
+		if (_phast)
+		{
+			auto& distances = _phast_distances[worker];
+			std::array<unsigned, PHAST_LANES> starts, ends;
+
+			// lanes past the last trial route from node 0 to itself at no cost
+			starts.fill(0);
+			ends.fill(0);
+
+			for (unsigned j = first; j < last; ++j)
 			{
-				unsigned start = dist(rng);
-				unsigned end = dist(rng);
+				Philox rng(_options.seed, RandomStream::TRIAL_ENDPOINTS, _batch, j);
+				starts[j - first] = draw_endpoint(rng);
+				ends[j - first] = draw_endpoint(rng);
+			}
 
-				local_total_path_length += get_greedy_path_length(start, end);
+			if (_phast_lanes == PHAST_LANES)
+			{
+				_phast->run<PHAST_LANES>(ends, distances);
+			}
+			else
+			{
+				_phast->run<PHAST_LANES / 2>(std::span<const unsigned, PHAST_LANES / 2>(ends.data(), PHAST_LANES / 2), distances);
 			}
 
-			return local_total_path_length;
-		}));
-	}
+			for (unsigned lane = 0; lane < _phast_lanes; ++lane)
+			{
+				add_greedy_path_lengths(starts[lane], ends[lane], first + lane, distances, _phast_lanes, lane, totals);
+			}
+		}
+		else
+		{
+			for (unsigned j = first; j < last; ++j)
+			{
+				Philox rng(_options.seed, RandomStream::TRIAL_ENDPOINTS, _batch, j);
+				unsigned start = draw_endpoint(rng);
+				unsigned end = draw_endpoint(rng);
+
+				add_greedy_path_lengths(start, end, j, totals);
+			}
+		}
+	});
+
+	std::vector<double> total_path_lengths(num_exponents, 0.0);
 
-	for (auto& future : futures)
+	for (unsigned worker = 0; worker < pool.size(); ++worker)
 	{
-		total_path_length += future.get();
+		for (unsigned e = 0; e < num_exponents; ++e)
+		{
+			total_path_lengths[e] += worker_totals[size_t(worker) * num_exponents + e];
+		}
 	}
 
-	return total_path_length;
+	return total_path_lengths;
+}
+
+template <DistanceOracle Oracle>
+unsigned Highway<Oracle>::get_failed_trials() const noexcept
+{
+	return _failed_trials;
 }
 
-double Highway::get_average_greedy_path_length(unsigned batch_size, double fractional_difference) noexcept
+template <DistanceOracle Oracle>
+double Highway<Oracle>::get_avoided_queries_per_hop() const noexcept
 {
-	double total_path_length = 0.0;
-	unsigned iteration = 0;
-	unsigned iterations_since_last_change = 0;
-	double min_in_range = std::numeric_limits<double>::max();
-	double max_in_range = std::numeric_limits<double>::min();
-	double average;
+	return _landmark_hops == 0 ? 0.0 : double(_avoided_queries) / _landmark_hops;
+}
 
-	printf("Testing exponent: %f\n", _clustering_exponent);
+template <DistanceOracle Oracle>
+double Highway<Oracle>::get_average_greedy_path_length(unsigned batch_size, double relative_half_width) noexcept
+{
+	return get_average_greedy_path_lengths(batch_size, relative_half_width)[0].mean();
+}
+
+template <DistanceOracle Oracle>
+std::vector<RunningStatistics> Highway<Oracle>::get_average_greedy_path_lengths(unsigned batch_size, double relative_half_width) noexcept
+{
+	unsigned num_exponents = _clustering_exponents.size();
+
+	std::vector<RunningStatistics> batch_averages(num_exponents);
+	bool settled;
+
+	for (double clustering_exponent : _clustering_exponents)
+	{
+		printf("Testing exponent: %f\n", clustering_exponent);
+	}
 
 	do
 	{
 		initialize();
-		total_path_length += get_total_greedy_path_length(batch_size);
-		++iteration;
+		auto batch_path_lengths = get_total_greedy_path_lengths(batch_size);
+
+		// trials between nodes that cannot reach each other add nothing and are left out
+		unsigned num_routed = batch_size - _failed_trials;
+
+		if (_failed_trials > 0)
+		{
+			printf("%u of %u trials had an end their start cannot reach\n", unsigned(_failed_trials), batch_size);
+		}
+
+		// a whole batch without a connected pair leaves nothing to average, and later ones would hardly do better
+		if (num_routed == 0)
+		{
+			break;
+		}
 
-		printf("Iteration: %u, Average path length: %f\n", iteration, total_path_length / (iteration * batch_size));
+		printf("Iteration: %u, Average path length:", batch_averages[0].count() + 1);
 
-		++iterations_since_last_change;
-		average = total_path_length / (iteration * batch_size);
-		min_in_range = std::min(min_in_range, average);
-		max_in_range = std::max(max_in_range, average);
+		settled = true;
 
-		if ((max_in_range - min_in_range) / min_in_range > fractional_difference)
+		for (unsigned e = 0; e < num_exponents; ++e)
 		{
-			iterations_since_last_change = 0;
-			min_in_range = max_in_range = average;
+			batch_averages[e].add(batch_path_lengths[e] / num_routed);
+
+			double half_width = CONFIDENCE_Z * batch_averages[e].standard_error();
+			settled = settled && half_width <= relative_half_width * batch_averages[e].mean();
+
+			printf(" %f +- %f", batch_averages[e].mean(), half_width);
 		}
 
-	} while (iterations_since_last_change < std::max(10u, iteration / 2));
+		printf("\n");
+
+		if (_landmark_hops > 0)
+		{
+			printf("Contact distance queries avoided by landmarks per hop: %f\n", get_avoided_queries_per_hop());
+		}
 
-	double tolerance = (max_in_range - min_in_range) / min_in_range;
-	double rounded_average = std::round(average / tolerance) * tolerance;
+	} while (!settled || batch_averages[0].count() < MIN_BATCHES);
 
-	save_clustering_exponent_data(_name, _k, _Q, _clustering_exponent, rounded_average);
+	for (unsigned e = 0; e < num_exponents && batch_averages[e].count() > 0; ++e)
+	{
+		save_clustering_exponent_data(_name, _k, _Q, _clustering_exponents[e], batch_averages[e].mean(), batch_averages[e].standard_error(), batch_averages[e].count() * batch_size);
+	}
 
-	return average;
+	return batch_averages;
 }
 
-double Highway::estimate_optimal_clustering_exponent(double guess, unsigned batch_size, double tolerance) noexcept
+template <DistanceOracle Oracle>
+double Highway<Oracle>::estimate_optimal_clustering_exponent(double guess, unsigned batch_size, double tolerance) noexcept
 {
 	struct Params
 	{
 		const std::string& name;
-		const RoutingKit::ContractionHierarchy& contraction_hierarchy;
+		const Oracle& oracle;
 		unsigned k;
 		unsigned Q;
+		const HighwayOptions& options;
 		unsigned batch_size;
 	};
 
-	Params params = { _name, _contraction_hierarchy, _k, _Q, batch_size };
+	Params params = { _name, _oracle, _k, _Q, _options, batch_size };
 
 	auto get_average_greedy_path_length_wrapper = [](double clustering_exponent, void* params) -> double {
 		Params* p = static_cast<Params*>(params);
 
-		Highway h(p->name, p->contraction_hierarchy, p->k, p->Q, clustering_exponent);
+		Highway h(p->name, p->oracle, p->k, p->Q, clustering_exponent, p->options);
 		return h.get_average_greedy_path_length(p->batch_size);
 	};
 
@@ -253,3 +786,69 @@ double Highway::estimate_optimal_clustering_exponent(double guess, unsigned batc
 
 	return clustering_exponent;
 }
+
+template <DistanceOracle Oracle>
+double Highway<Oracle>::estimate_optimal_clustering_exponent_from_curve(unsigned num_exponents, unsigned batch_size, double tolerance) noexcept
+{
+	double lower_bound = 0.01;
+	double upper_bound = 2.5;
+
+	num_exponents = std::max(num_exponents, MIN_CURVE_EXPONENTS);
+
+	while (true)
+	{
+		double spacing = (upper_bound - lower_bound) / (num_exponents - 1);
+
+		std::vector<double> clustering_exponents(num_exponents);
+
+		for (unsigned i = 0; i < num_exponents; ++i)
+		{
+			clustering_exponents[i] = lower_bound + i * spacing;
+		}
+
+		// the resolved seed is passed on, so every round also sees the same highway nodes and trial endpoints
+		Highway h(_name, _oracle, _k, _Q, clustering_exponents, _options);
+		auto curve = h.get_average_greedy_path_lengths(batch_size);
+
+		auto by_mean = [](const RunningStatistics& a, const RunningStatistics& b) { return a.mean() < b.mean(); };
+		unsigned minimum = std::min_element(curve.begin(), curve.end(), by_mean) - curve.begin();
+
+		printf("Minimum at exponent %f: %f +- %f\n", clustering_exponents[minimum], curve[minimum].mean(), CONFIDENCE_Z * curve[minimum].standard_error());
+
+		// keep a neighbour on either side, even when the minimum is at the edge of the grid
+		unsigned middle = std::clamp(minimum, 1u, num_exponents - 2);
+
+		if (spacing < tolerance)
+		{
+			double left = curve[middle - 1].mean();
+			double centre = curve[middle].mean();
+			double right = curve[middle + 1].mean();
+			double curvature = left - 2 * centre + right;
+
+			// a curvature within the noise would put the vertex anywhere
+			if (curvature <= CONFIDENCE_Z * curve[middle].standard_error())
+			{
+				return clustering_exponents[minimum];
+			}
+
+			double offset = spacing * (left - right) / (2 * curvature);
+			return clustering_exponents[middle] + std::clamp(offset, -spacing, spacing);
+		}
+
+		// a grid that stopped narrowing would rebuild the same Highway forever
+		if (clustering_exponents[middle + 1] - clustering_exponents[middle - 1] >= upper_bound - lower_bound)
+		{
+			return clustering_exponents[minimum];
+		}
+
+		lower_bound = clustering_exponents[middle - 1];
+		upper_bound = clustering_exponents[middle + 1];
+	}
+}
+
+template class Highway<ContractionHierarchyOracle>;
+template class Highway<ChainCompressionOracle>;
+template class Highway<LatticeOracle<1>>;
+template class Highway<LatticeOracle<2>>;
+template class Highway<LatticeOracle<3>>;
+template class Highway<LatticeOracle<4>>;
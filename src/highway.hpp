@@ -1,45 +1,207 @@
 #pragma once
 
+#include "coordinates.hpp"
+#include "distance_oracle.hpp"
+#include "highway_distance_matrix.hpp"
+#include "landmarks.hpp"
+#include "original_graph.hpp"
+#include "phast.hpp"
+#include "philox.hpp"
+#include "running_statistics.hpp"
+#include "shortest_path_tree.hpp"
+#include "thread_pool.hpp"
+
 #include <routingkit/contraction_hierarchy.h>
 
+#include <atomic>
+#include <optional>
+#include <span>
 #include <string>
-#include <thread>
 #include <functional>
+#include <type_traits>
 #include <vector>
 
-// static const unsigned NUM_THREADS = 1;
-static const unsigned NUM_THREADS = std::thread::hardware_concurrency();
+// trials per work-stealing chunk in get_total_greedy_path_length
+static const unsigned TRIAL_CHUNK_SIZE = 4;
+
+// get_average_greedy_path_length runs batches until the 95% confidence interval of the mean is narrow enough,
+// but never fewer than MIN_BATCHES, so that the variance it is judged by is itself reasonably settled
+static const double CONFIDENCE_Z = 1.96;
+static const unsigned MIN_BATCHES = 10;
+
+// estimate_optimal_clustering_exponent_from_curve narrows its grid to the two spacings around the minimum, which only
+// shrinks the interval if there are more than 3 points; with at least 5 it halves or better every round
+static const unsigned MIN_CURVE_EXPONENTS = 5;
+
+enum class ContactSampling
+{
+	FROZEN,    // each highway node draws its k * Q contacts once per initialize()
+	RESAMPLED  // contacts are redrawn every time greedy routing visits a highway node
+};
+
+// only used over a contraction hierarchy; any other oracle is asked for distances and next hops directly
+enum class GreedyRouting
+{
+	CH_QUERIES,   // one CH query per hop for the next hop, and one per candidate for its distance to the target
+	REVERSE_TREE, // one bounded backward Dijkstra from the target per trial; every hop is then array lookups
+	PHAST         // one PHAST sweep gives every node's distance to the targets of PHAST_LANES trials at once
+};
+
+enum class GreedyMetric
+{
+	ROAD_DISTANCE, // shortest path distances, from whichever GreedyRouting is used
+	EUCLIDEAN,     // straight-line distances between the nodes' coordinates
+	GREAT_CIRCLE   // great-circle distances between the nodes' coordinates, taken as longitude and latitude
+};
+
+struct HighwayOptions
+{
+	ContactSampling contact_sampling = ContactSampling::FROZEN;
+	GreedyRouting greedy_routing = GreedyRouting::REVERSE_TREE;
+
+	// The geometric metrics rank contacts by how close they are to the target in coordinates (indexed by node, as
+	// from get_coordinates). Local hops still follow shortest paths, and a contact is only taken if it can reach the
+	// target, so each contact still costs a road distance: an array lookup with REVERSE_TREE (which then grows the whole
+	// tree, not just the ball through the start) and PHAST, a CH query with CH_QUERIES.
+	GreedyMetric greedy_metric = GreedyMetric::ROAD_DISTANCE;
+	std::span<const Coordinate> coordinates;
+
+	// the component of every node, as from Graph::components(); if given, trial endpoints are only drawn from
+	// component 0, the largest, so that no trial is spent on a pair of nodes that cannot reach each other
+	std::span<const unsigned> components;
+
+	// With CH_QUERIES and road distances, contacts are first judged by landmark bounds on their distance to the target:
+	// most are dropped, and a lone survivor that surely beats the local contact is taken, without an exact CH query.
+	const Landmarks* landmarks = nullptr;
 
+	// every random draw is keyed by (seed, batch, item); 0 draws a seed from std::random_device.
+	// Highways sharing a seed see the same highway nodes and trial endpoints in every batch.
+	uint64_t seed = 0;
+};
+
+// A Highway simulates greedy routing for one or more clustering exponents at once. All exponents share the
+// highway nodes, the trial endpoints, every distance computation and the random numbers (common random
+// numbers); only the contact-sampling weights differ, so one pass gives a whole path length vs. exponent curve.
+// Shortest path distances come from the Oracle, fixed at compile time: a contraction hierarchy for road networks,
+// possibly only over the core of a ChainCompression, or arithmetic for lattices, which then need no hierarchy at all.
+// Highway is instantiated in highway.cpp for ContractionHierarchyOracle, ChainCompressionOracle and for LatticeOracle
+// of 1 to 4 dimensions.
+template <DistanceOracle Oracle = ContractionHierarchyOracle>
 class Highway
 {
 public:
-	Highway(const std::string& name, const RoutingKit::ContractionHierarchy& ch, unsigned k, unsigned Q, double clustering_exponent);
+	Highway(const std::string& name, Oracle oracle, unsigned k, unsigned Q, double clustering_exponent, const HighwayOptions& options = {});
+
+	Highway(const std::string& name, Oracle oracle, unsigned k, unsigned Q, const std::vector<double>& clustering_exponents, const HighwayOptions& options = {});
 
 	const std::string& name() const noexcept;
 
+	const std::vector<double>& clustering_exponents() const noexcept;
+
 	void initialize() noexcept;
 
-	void for_each_long_distance_contact(unsigned u, const std::function<void(unsigned)>& callback) const noexcept;
+	// rng is only drawn from when contacts are resampled on every visit
+	void for_each_long_distance_contact(unsigned u, Philox& rng, const std::function<void(unsigned)>& callback) const noexcept;
+
+	// the contacts u gets under the exponent_index-th clustering exponent
+	void for_each_long_distance_contact(unsigned u, unsigned exponent_index, Philox& rng, const std::function<void(unsigned)>& callback) const noexcept;
+
+	std::span<const unsigned> get_frozen_contacts(unsigned u, unsigned exponent_index = 0) const noexcept;
 
 	unsigned get_distance(unsigned s, unsigned t) const noexcept;
 
-	unsigned get_greedy_path_length(unsigned start, unsigned end) const noexcept;
+	// trial keys the random numbers of resampled contacts within the current batch; uses the first exponent.
+	// 0 if start cannot reach end, which is then counted as a failed trial.
+	unsigned get_greedy_path_length(unsigned start, unsigned end, unsigned trial = 0) const noexcept;
 
+	// total over num_trials trials for the first exponent
 	double get_total_greedy_path_length(unsigned num_trials) const noexcept;
 
-	double get_average_greedy_path_length(unsigned batch_size = 1000, double fractional_difference = 5e-4) noexcept;
+	// totals over the same num_trials trials for every exponent; failed trials add nothing (see get_failed_trials)
+	std::vector<double> get_total_greedy_path_lengths(unsigned num_trials) const noexcept;
+
+	// contact distance queries that landmark bounds made unnecessary, per hop, since the last initialize()
+	double get_avoided_queries_per_hop() const noexcept;
+
+	// Trials since the last initialize() whose start cannot reach their end, which only a directed graph without
+	// HighwayOptions::components can draw. They are not routed, add nothing to the totals, and are left out of averages.
+	unsigned get_failed_trials() const noexcept;
+
+	// runs batches until the confidence interval's half-width is at most relative_half_width times the mean
+	double get_average_greedy_path_length(unsigned batch_size = 1000, double relative_half_width = 1e-3) noexcept;
+
+	// the path length vs. exponent curve, as statistics over batch means (a batch's trials share one highway and are
+	// correlated, the batches are not); batches are run until every exponent's confidence interval is narrow enough
+	std::vector<RunningStatistics> get_average_greedy_path_lengths(unsigned batch_size = 1000, double relative_half_width = 1e-3) noexcept;
 
 	double estimate_optimal_clustering_exponent(double guess = 1.5, unsigned batch_size = NUM_THREADS * 100, double tolerance = 5e-3) noexcept;
 
+	// Evaluates num_exponents (at least MIN_CURVE_EXPONENTS) evenly spaced exponents in one pass, then narrows the grid
+	// to the neighbours of the minimum until its spacing is below tolerance. The result is the vertex of a parabola
+	// through the final minimum.
+	double estimate_optimal_clustering_exponent_from_curve(unsigned num_exponents = 16, unsigned batch_size = NUM_THREADS * 100, double tolerance = 5e-3) noexcept;
+
 private:
+	static constexpr bool USES_CONTRACTION_HIERARCHY = std::is_same_v<Oracle, ContractionHierarchyOracle>;
+
+	// route_greedily under the chosen metric: road_distance_to_end for road distances, the coordinates otherwise
+	template <typename RoadDistanceToEnd, typename NextHop>
+	unsigned route_greedily(unsigned exponent_index, unsigned start, unsigned end, Philox& rng, RoadDistanceToEnd&& road_distance_to_end, NextHop&& next_hop) const noexcept;
+
+	void sample_long_distance_contacts(unsigned u, unsigned exponent_index, Philox& rng, const std::function<void(unsigned)>& callback) const noexcept;
+
+	void freeze_long_distance_contacts() noexcept;
+
+	// adds the path length of one trial under each of the first path_lengths.size() exponents to path_lengths,
+	// finding the distances to end only once
+	void add_greedy_path_lengths(unsigned start, unsigned end, unsigned trial, std::span<double> path_lengths) const noexcept;
+
+	// the same, given every node's distance to end in lane `lane` of a PHAST result
+	void add_greedy_path_lengths(unsigned start, unsigned end, unsigned trial, const std::vector<unsigned>& distances, unsigned num_lanes, unsigned lane, std::span<double> path_lengths) const noexcept;
+
 	const std::string& _name;
-	const RoutingKit::ContractionHierarchy& _contraction_hierarchy;
+	Oracle _oracle;
 	unsigned _k;
 	unsigned _Q;
-	double _clustering_exponent;
+	std::vector<double> _clustering_exponents;
+	HighwayOptions _options;
 
 	unsigned _num_nodes;
 
+	// incremented by every initialize()
+	unsigned _batch = 0;
+
+	// the nodes trial endpoints are drawn from; empty for all of them
+	std::vector<unsigned> _trial_nodes;
+
 	std::vector<unsigned> _highway_nodes; 
 	std::vector<bool> _is_highway_node;
+
+	HighwayDistanceMatrix<Oracle> _distance_matrix;
+
+	// only over a contraction hierarchy, as the chosen GreedyRouting needs them
+	std::optional<OriginalGraph> _reverse_graph;
+	std::optional<OriginalGraph> _forward_graph;
+	std::optional<PHAST> _phast;
+
+	// the lanes of a PHAST sweep, and one sweep buffer per pool worker, reserved from the distance matrix budget
+	unsigned _phast_lanes = 0;
+	DistanceMatrixReservation _phast_reservation;
+	mutable std::vector<std::vector<unsigned>> _phast_distances;
+
+	// CSR-style contact table, one block of |H| * k * Q per exponent: under exponent e, highway node
+	// _highway_nodes[i] owns _frozen_contacts[(e * |H| + i) * k * Q, (e * |H| + i + 1) * k * Q)
+	std::vector<unsigned> _highway_index;
+	std::vector<unsigned> _frozen_contacts;
+
+	// hops routed with landmarks and the contact distance queries avoided in them, since the last initialize()
+	mutable std::atomic<uint64_t> _landmark_hops = 0;
+	mutable std::atomic<uint64_t> _avoided_queries = 0;
+
+	mutable std::atomic<unsigned> _failed_trials = 0;
 };
+
+// Highway h(name, ch, ...) routes over the contraction hierarchy
+Highway(const std::string&, const RoutingKit::ContractionHierarchy&, unsigned, unsigned, double, const HighwayOptions& = {}) -> Highway<ContractionHierarchyOracle>;
+
+Highway(const std::string&, const RoutingKit::ContractionHierarchy&, unsigned, unsigned, const std::vector<double>&, const HighwayOptions& = {}) -> Highway<ContractionHierarchyOracle>;
@@ -0,0 +1,299 @@
+#include "highway_distance_matrix.hpp"
+
+#include "thread_pool.hpp"
+
+#include <routingkit/constants.h>
+#include <routingkit/contraction_hierarchy.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// number of targets whose backward search spaces are bucketed at once
+	const unsigned TILE_SIZE = 8192;
+
+	// upward searches per work-stealing chunk
+	const unsigned SEARCH_CHUNK_SIZE = 16;
+
+	std::atomic<size_t> distance_matrix_memory_budget = DEFAULT_DISTANCE_MATRIX_MEMORY_BUDGET;
+	std::atomic<size_t> distance_matrix_memory_in_use = 0;
+
+	struct BucketEntry
+	{
+		unsigned rank;
+		unsigned column;
+		unsigned distance;
+	};
+
+	// Dijkstra restricted to the upward arcs of one side of the hierarchy; nodes are ranks.
+	// Only the nodes a run reached are reset, so a thread_local search is cheap to reuse.
+	class UpwardSearch
+	{
+	public:
+		void run(const RoutingKit::ContractionHierarchy::Side& side, unsigned source, const std::function<void(unsigned, unsigned)>& settle) noexcept
+		{
+			unsigned num_nodes = side.first_out.size() - 1;
+			if (_distances.size() != num_nodes)
+			{
+				_distances.assign(num_nodes, RoutingKit::inf_weight);
+				_reached.clear();
+			}
+
+			for (unsigned node : _reached)
+			{
+				_distances[node] = RoutingKit::inf_weight;
+			}
+			_reached.clear();
+
+			_distances[source] = 0;
+			_reached.push_back(source);
+			_queue.push({0, source});
+
+			while (!_queue.empty())
+			{
+				auto [distance, node] = _queue.top();
+				_queue.pop();
+
+				if (distance > _distances[node])
+				{
+					continue;
+				}
+
+				settle(node, distance);
+
+				for (unsigned arc = side.first_out[node]; arc < side.first_out[node + 1]; ++arc)
+				{
+					unsigned head = side.head[arc];
+					unsigned new_distance = distance + side.weight[arc];
+
+					if (new_distance < _distances[head])
+					{
+						if (_distances[head] == RoutingKit::inf_weight)
+						{
+							_reached.push_back(head);
+						}
+
+						_distances[head] = new_distance;
+						_queue.push({new_distance, head});
+					}
+				}
+			}
+		}
+
+	private:
+		std::vector<unsigned> _distances;
+		std::vector<unsigned> _reached;
+		std::priority_queue<std::pair<unsigned, unsigned>, std::vector<std::pair<unsigned, unsigned>>, std::greater<>> _queue;
+	};
+
+	// fills the columns [first_target, last_target) of the highway-to-highway distance matrix
+	void build_tile(const RoutingKit::ContractionHierarchy& ch, const std::vector<unsigned>& highway_nodes, std::vector<unsigned>& matrix, unsigned first_target, unsigned last_target) noexcept
+	{
+		unsigned num_nodes = ch.node_count();
+		unsigned num_highway_nodes = highway_nodes.size();
+
+		auto& pool = ThreadPool::instance();
+
+		// backward searches from the tile's targets, each worker collecting its own bucket entries
+		std::vector<std::vector<BucketEntry>> worker_entries(pool.size());
+
+		pool.parallel_for(last_target - first_target, SEARCH_CHUNK_SIZE, [&ch, &highway_nodes, first_target, &worker_entries](unsigned first, unsigned last, unsigned worker) noexcept
+		{
+			thread_local UpwardSearch search;
+
+			for (unsigned column = first_target + first; column < first_target + last; ++column)
+			{
+				unsigned target = ch.rank[highway_nodes[column]];
+				search.run(ch.backward, target, [&](unsigned rank, unsigned distance)
+				{
+					worker_entries[worker].push_back({rank, column, distance});
+				});
+			}
+		});
+
+		// counting sort of all entries by rank into CSR buckets
+		std::vector<unsigned> bucket_first(num_nodes + 1, 0);
+
+		for (const auto& entries : worker_entries)
+		{
+			for (const auto& entry : entries)
+			{
+				++bucket_first[entry.rank + 1];
+			}
+		}
+
+		for (unsigned rank = 0; rank < num_nodes; ++rank)
+		{
+			bucket_first[rank + 1] += bucket_first[rank];
+		}
+
+		std::vector<BucketEntry> buckets(bucket_first[num_nodes]);
+		std::vector<unsigned> bucket_end(bucket_first.begin(), bucket_first.end() - 1);
+
+		for (auto& entries : worker_entries)
+		{
+			for (const auto& entry : entries)
+			{
+				buckets[bucket_end[entry.rank]++] = entry;
+			}
+
+			entries = {};
+		}
+
+		// forward searches from every highway node, scanning the buckets of each settled node
+		pool.parallel_for(num_highway_nodes, SEARCH_CHUNK_SIZE, [&ch, &highway_nodes, &matrix, num_highway_nodes, &bucket_first, &buckets](unsigned first, unsigned last, unsigned) noexcept
+		{
+			thread_local UpwardSearch search;
+
+			for (unsigned row = first; row < last; ++row)
+			{
+				unsigned* distances = matrix.data() + size_t(row) * num_highway_nodes;
+				unsigned source = ch.rank[highway_nodes[row]];
+
+				search.run(ch.forward, source, [&](unsigned rank, unsigned distance)
+				{
+					for (unsigned b = bucket_first[rank]; b < bucket_first[rank + 1]; ++b)
+					{
+						const auto& entry = buckets[b];
+						distances[entry.column] = std::min(distances[entry.column], distance + entry.distance);
+					}
+				});
+			}
+		});
+	}
+}
+
+void set_distance_matrix_memory_budget(size_t bytes) noexcept
+{
+	distance_matrix_memory_budget = bytes;
+}
+
+DistanceMatrixReservation::DistanceMatrixReservation(DistanceMatrixReservation&& other) noexcept :
+	_bytes(std::exchange(other._bytes, 0))
+{
+}
+
+DistanceMatrixReservation& DistanceMatrixReservation::operator=(DistanceMatrixReservation&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		_bytes = std::exchange(other._bytes, 0);
+	}
+
+	return *this;
+}
+
+DistanceMatrixReservation::~DistanceMatrixReservation()
+{
+	release();
+}
+
+bool DistanceMatrixReservation::reserve(size_t bytes) noexcept
+{
+	release();
+
+	size_t in_use = distance_matrix_memory_in_use.load();
+	do
+	{
+		if (bytes > distance_matrix_memory_budget.load() || in_use > distance_matrix_memory_budget.load() - bytes)
+		{
+			return false;
+		}
+	} while (!distance_matrix_memory_in_use.compare_exchange_weak(in_use, in_use + bytes));
+
+	_bytes = bytes;
+
+	return true;
+}
+
+void DistanceMatrixReservation::release() noexcept
+{
+	distance_matrix_memory_in_use -= std::exchange(_bytes, 0);
+}
+
+template <DistanceOracle Oracle>
+HighwayDistanceMatrix<Oracle>::HighwayDistanceMatrix(const Oracle& oracle) :
+	_oracle(oracle)
+{
+}
+
+template <DistanceOracle Oracle>
+void HighwayDistanceMatrix<Oracle>::build(const std::vector<unsigned>& highway_nodes) noexcept
+{
+	_highway_nodes = highway_nodes;
+	_distances.clear();
+	_distances.shrink_to_fit();
+
+	size_t num_highway_nodes = _highway_nodes.size();
+	if (num_highway_nodes == 0 || !_reservation.reserve(num_highway_nodes * num_highway_nodes * sizeof(unsigned)))
+	{
+		return;
+	}
+
+	_distances.assign(num_highway_nodes * num_highway_nodes, RoutingKit::inf_weight);
+
+	if constexpr (!std::is_same_v<Oracle, ContractionHierarchyOracle>)
+	{
+		build_rows();
+	}
+	else
+	{
+		for (unsigned first_target = 0; first_target < num_highway_nodes; first_target += TILE_SIZE)
+		{
+			build_tile(_oracle.contraction_hierarchy(), _highway_nodes, _distances, first_target, std::min<size_t>(first_target + TILE_SIZE, num_highway_nodes));
+		}
+	}
+}
+
+template <DistanceOracle Oracle>
+void HighwayDistanceMatrix<Oracle>::build_rows() noexcept
+{
+	size_t num_highway_nodes = _highway_nodes.size();
+
+	ThreadPool::instance().parallel_for(num_highway_nodes, SEARCH_CHUNK_SIZE, [this, num_highway_nodes](unsigned first, unsigned last, unsigned) noexcept
+	{
+		thread_local std::vector<unsigned> row;
+
+		for (unsigned i = first; i < last; ++i)
+		{
+			_oracle.one_to_many(_highway_nodes[i], _highway_nodes, row);
+			std::copy(row.begin(), row.end(), _distances.begin() + i * num_highway_nodes);
+		}
+	});
+}
+
+template <DistanceOracle Oracle>
+bool HighwayDistanceMatrix<Oracle>::is_materialized() const noexcept
+{
+	return !_distances.empty();
+}
+
+template <DistanceOracle Oracle>
+std::span<const unsigned> HighwayDistanceMatrix<Oracle>::get_row(unsigned i, std::vector<unsigned>& buffer) const noexcept
+{
+	size_t num_highway_nodes = _highway_nodes.size();
+
+	if (is_materialized())
+	{
+		return { _distances.data() + i * num_highway_nodes, num_highway_nodes };
+	}
+
+	_oracle.one_to_many(_highway_nodes[i], _highway_nodes, buffer);
+
+	return buffer;
+}
+
+template class HighwayDistanceMatrix<ContractionHierarchyOracle>;
+template class HighwayDistanceMatrix<ChainCompressionOracle>;
+template class HighwayDistanceMatrix<LatticeOracle<1>>;
+template class HighwayDistanceMatrix<LatticeOracle<2>>;
+template class HighwayDistanceMatrix<LatticeOracle<3>>;
+template class HighwayDistanceMatrix<LatticeOracle<4>>;
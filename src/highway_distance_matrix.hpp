@@ -0,0 +1,60 @@
+#pragma once
+
+#include "distance_oracle.hpp"
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// 4 GiB holds the full matrix for up to ~32k highway nodes
+static const size_t DEFAULT_DISTANCE_MATRIX_MEMORY_BUDGET = size_t(4) << 30;
+
+// The budget is shared by every HighwayDistanceMatrix in the process, since the clustering exponent searches and the
+// drivers keep several Highways alive at once. The PHAST sweep buffers of Highways and of dimension estimates, each a
+// distance per node and lane, are charged to it as well. It starts at DEFAULT_DISTANCE_MATRIX_MEMORY_BUDGET; with 0,
+// every row is computed on demand and nothing sweeps with PHAST. Lowering it does not evict what is already reserved.
+void set_distance_matrix_memory_budget(size_t bytes) noexcept;
+
+// bytes taken from the shared budget, given back when released or destroyed
+class DistanceMatrixReservation
+{
+public:
+	DistanceMatrixReservation() noexcept = default;
+	DistanceMatrixReservation(DistanceMatrixReservation&& other) noexcept;
+	DistanceMatrixReservation& operator=(DistanceMatrixReservation&& other) noexcept;
+	~DistanceMatrixReservation();
+
+	// releases what is held, then takes bytes if what is left of the budget has room for them
+	bool reserve(size_t bytes) noexcept;
+	void release() noexcept;
+
+private:
+	size_t _bytes = 0;
+};
+
+// Highway-to-highway distances, recomputed whenever the highway node set changes.
+// If the full |H| x |H| matrix fits in the memory budget it is built up front: over a contraction hierarchy with a
+// bucket-based many-to-many CH search in parallel tiles of targets, over any other oracle one row per highway node.
+// Otherwise, or if other matrices hold too much of the shared budget, rows are computed on demand. Instantiated in highway_distance_matrix.cpp, as Highway is.
+template <DistanceOracle Oracle>
+class HighwayDistanceMatrix
+{
+public:
+	explicit HighwayDistanceMatrix(const Oracle& oracle);
+
+	void build(const std::vector<unsigned>& highway_nodes) noexcept;
+
+	bool is_materialized() const noexcept;
+
+	// distances from the i-th highway node to every highway node; buffer is only used for on-demand rows
+	std::span<const unsigned> get_row(unsigned i, std::vector<unsigned>& buffer) const noexcept;
+
+private:
+	void build_rows() noexcept;
+
+	Oracle _oracle;
+	DistanceMatrixReservation _reservation;
+
+	std::vector<unsigned> _highway_nodes;
+	std::vector<unsigned> _distances;
+};
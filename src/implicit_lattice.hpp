@@ -0,0 +1,231 @@
+#pragma once
+
+#include "graph.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// A side_length^DIMENSION grid graph with unit weights that stores no adjacency: neighbors, the index/coordinate
+// mapping and distances are all arithmetic. Indices are 64-bit; the node with coordinates c has index
+// sum(c[d] * side_length^d). With wrap_around, every dimension is a cycle (a torus).
+template <unsigned DIMENSION>
+class ImplicitLattice
+{
+public:
+	using Coordinates = std::array<unsigned, DIMENSION>;
+
+	ImplicitLattice(unsigned side_length, bool wrap_around = false) :
+		_side_length(side_length), _wrap_around(wrap_around)
+	{
+		uint64_t stride = 1;
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			_strides[d] = stride;
+			stride *= side_length;
+		}
+
+		_size = stride;
+	}
+
+	uint64_t size() const noexcept
+	{
+		return _size;
+	}
+
+	unsigned side_length() const noexcept
+	{
+		return _side_length;
+	}
+
+	bool wrap_around() const noexcept
+	{
+		return _wrap_around;
+	}
+
+	Coordinates coordinates(uint64_t index) const noexcept
+	{
+		Coordinates coordinates;
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			coordinates[d] = index % _side_length;
+			index /= _side_length;
+		}
+
+		return coordinates;
+	}
+
+	uint64_t index(const Coordinates& coordinates) const noexcept
+	{
+		uint64_t index = 0;
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			index += coordinates[d] * _strides[d];
+		}
+
+		return index;
+	}
+
+	// calls callback(neighbor) for each of the (up to) 2 * DIMENSION nodes one step away
+	template <typename Callback>
+	void for_each_neighbor(uint64_t index, Callback&& callback) const noexcept
+	{
+		uint64_t remaining = index;
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			unsigned coordinate = remaining % _side_length;
+			remaining /= _side_length;
+
+			if (coordinate > 0)
+			{
+				callback(index - _strides[d]);
+			}
+			else if (_wrap_around && _side_length > 2)
+			{
+				callback(index + (_side_length - 1) * _strides[d]);
+			}
+
+			if (coordinate + 1 < _side_length)
+			{
+				callback(index + _strides[d]);
+			}
+			else if (_wrap_around && _side_length > 2)
+			{
+				callback(index - (_side_length - 1) * _strides[d]);
+			}
+		}
+	}
+
+	// the L1 distance, measured around each cycle with wrap_around
+	uint64_t distance(uint64_t s, uint64_t t) const noexcept
+	{
+		uint64_t distance = 0;
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			distance += axis_distance(s % _side_length, t % _side_length);
+			s /= _side_length;
+			t /= _side_length;
+		}
+
+		return distance;
+	}
+
+	// the neighbor of s one step towards t along the first dimension in which they differ (s itself if s == t);
+	// with wrap_around, the step goes whichever way around the cycle is shorter
+	uint64_t next_hop(uint64_t s, uint64_t t) const noexcept
+	{
+		uint64_t remaining_s = s;
+		uint64_t remaining_t = t;
+
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			unsigned a = remaining_s % _side_length;
+			unsigned b = remaining_t % _side_length;
+			remaining_s /= _side_length;
+			remaining_t /= _side_length;
+
+			if (a == b)
+			{
+				continue;
+			}
+
+			unsigned steps_up = b > a ? b - a : b + _side_length - a;
+			bool up = _wrap_around ? steps_up <= _side_length - steps_up : b > a;
+
+			if (up)
+			{
+				return a + 1 < _side_length ? s + _strides[d] : s - (_side_length - 1) * _strides[d];
+			}
+
+			return a > 0 ? s - _strides[d] : s + (_side_length - 1) * _strides[d];
+		}
+
+		return s;
+	}
+
+	unsigned axis_distance(unsigned a, unsigned b) const noexcept
+	{
+		unsigned difference = a > b ? a - b : b - a;
+		return _wrap_around ? std::min(difference, _side_length - difference) : difference;
+	}
+
+	// The balls of u in closed form, without a search: the number of nodes at each distance is the convolution over
+	// the dimensions of the number of coordinates at each distance along one axis. Graph::get_balls records one ball
+	// per node, but tight_c only sees the extremes, so for each distance only the first and the last count are
+	// recorded. Counts are 32-bit, so the lattice should have fewer than 2^32 nodes.
+	std::vector<Ball> get_balls(uint64_t u) const
+	{
+		Coordinates source = coordinates(u);
+
+		// nodes_at[r] is the number of nodes at distance r within the dimensions convolved so far
+		std::vector<uint64_t> nodes_at = { 1 };
+		std::vector<uint64_t> axis_nodes_at;
+
+		for (unsigned d = 0; d < DIMENSION; ++d)
+		{
+			axis_nodes_at.assign(_side_length, 0);
+			for (unsigned coordinate = 0; coordinate < _side_length; ++coordinate)
+			{
+				++axis_nodes_at[axis_distance(source[d], coordinate)];
+			}
+
+			while (axis_nodes_at.back() == 0)
+			{
+				axis_nodes_at.pop_back();
+			}
+
+			std::vector<uint64_t> convolved(nodes_at.size() + axis_nodes_at.size() - 1, 0);
+			for (unsigned i = 0; i < nodes_at.size(); ++i)
+			{
+				for (unsigned j = 0; j < axis_nodes_at.size(); ++j)
+				{
+					convolved[i + j] += nodes_at[i] * axis_nodes_at[j];
+				}
+			}
+
+			nodes_at = std::move(convolved);
+		}
+
+		std::vector<Ball> balls;
+		uint64_t count = 0;
+
+		for (unsigned distance = 1; distance < nodes_at.size(); ++distance)
+		{
+			if (nodes_at[distance] == 0)
+			{
+				continue;
+			}
+
+			balls.push_back({ distance, unsigned(count + 1) });
+			count += nodes_at[distance];
+
+			if (nodes_at[distance] > 1)
+			{
+				balls.push_back({ distance, unsigned(count) });
+			}
+		}
+
+		return balls;
+	}
+
+	// materializes the lattice, for code that needs a Graph (or its contraction hierarchy)
+	GraphBuilder graph_builder() const
+	{
+		GraphBuilder builder(_size, true);
+
+		for (uint64_t u = 0; u < _size; ++u)
+		{
+			for_each_neighbor(u, [&](uint64_t v) { builder.add_edge(u, v, 1); });
+		}
+
+		return builder;
+	}
+
+private:
+	unsigned _side_length;
+	bool _wrap_around;
+
+	std::array<uint64_t, DIMENSION> _strides;
+	uint64_t _size;
+};
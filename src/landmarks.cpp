@@ -0,0 +1,132 @@
+#include "landmarks.hpp"
+
+#include "phast.hpp"
+
+#include <routingkit/constants.h>
+#include <routingkit/contraction_hierarchy.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// copies the rank-major lanes of a PHAST result into a node-major table
+	void copy_by_node(const RoutingKit::ContractionHierarchy& ch, const std::vector<unsigned>& distances, std::vector<unsigned, CacheAlignedAllocator<unsigned>>& table)
+	{
+		unsigned num_nodes = ch.node_count();
+		table.resize(size_t(num_nodes) * NUM_LANDMARKS);
+
+		for (unsigned node = 0; node < num_nodes; ++node)
+		{
+			auto first = distances.begin() + size_t(ch.rank[node]) * NUM_LANDMARKS;
+			std::copy(first, first + NUM_LANDMARKS, table.begin() + size_t(node) * NUM_LANDMARKS);
+		}
+	}
+}
+
+Landmarks::Landmarks(const RoutingKit::ContractionHierarchy& ch)
+{
+	unsigned num_nodes = ch.node_count();
+
+	PHAST from_sources(ch, PHAST::Direction::FROM_SOURCES);
+	PHAST to_targets(ch, PHAST::Direction::TO_TARGETS);
+
+	std::vector<unsigned> distances;
+
+	// the reachable node farthest away, by rank-indexed distances
+	auto farthest = [&ch](const std::vector<unsigned>& distances)
+	{
+		unsigned farthest_rank = 0;
+		unsigned max_distance = 0;
+
+		for (unsigned rank = 0; rank < distances.size(); ++rank)
+		{
+			if (distances[rank] != RoutingKit::inf_weight && distances[rank] > max_distance)
+			{
+				max_distance = distances[rank];
+				farthest_rank = rank;
+			}
+		}
+
+		return ch.order[farthest_rank];
+	};
+
+	// the selection starts from the node farthest from node 0; min_distances[rank] is the distance from the nearest landmark
+	std::array<unsigned, 1> source = { 0 };
+	from_sources.run<1>(source, distances);
+
+	unsigned landmark = farthest(distances);
+	std::vector<unsigned> min_distances(num_nodes, RoutingKit::inf_weight);
+
+	for (unsigned i = 0; i < NUM_LANDMARKS; ++i)
+	{
+		_landmarks.push_back(landmark);
+
+		source[0] = landmark;
+		from_sources.run<1>(source, distances);
+
+		for (unsigned rank = 0; rank < num_nodes; ++rank)
+		{
+			min_distances[rank] = std::min(min_distances[rank], distances[rank]);
+		}
+
+		landmark = farthest(min_distances);
+	}
+
+	// all landmarks share one sweep per direction
+	std::array<unsigned, NUM_LANDMARKS> landmarks;
+	std::copy(_landmarks.begin(), _landmarks.end(), landmarks.begin());
+
+	from_sources.run<NUM_LANDMARKS>(landmarks, distances);
+	copy_by_node(ch, distances, _from_landmarks);
+
+	to_targets.run<NUM_LANDMARKS>(landmarks, distances);
+	copy_by_node(ch, distances, _to_landmarks);
+}
+
+const std::vector<unsigned>& Landmarks::landmarks() const noexcept
+{
+	return _landmarks;
+}
+
+unsigned Landmarks::lower_bound(unsigned s, unsigned t) const noexcept
+{
+	return bounds(s, t).first;
+}
+
+unsigned Landmarks::upper_bound(unsigned s, unsigned t) const noexcept
+{
+	return bounds(s, t).second;
+}
+
+std::pair<unsigned, unsigned> Landmarks::bounds(unsigned s, unsigned t) const noexcept
+{
+	const unsigned* from_s = _from_landmarks.data() + size_t(s) * NUM_LANDMARKS;
+	const unsigned* from_t = _from_landmarks.data() + size_t(t) * NUM_LANDMARKS;
+	const unsigned* to_s = _to_landmarks.data() + size_t(s) * NUM_LANDMARKS;
+	const unsigned* to_t = _to_landmarks.data() + size_t(t) * NUM_LANDMARKS;
+
+	int64_t lower = 0;
+	uint64_t upper = RoutingKit::inf_weight;
+
+	for (unsigned l = 0; l < NUM_LANDMARKS; ++l)
+	{
+		bool from_finite = from_s[l] != RoutingKit::inf_weight && from_t[l] != RoutingKit::inf_weight;
+		bool to_finite = to_s[l] != RoutingKit::inf_weight && to_t[l] != RoutingKit::inf_weight;
+
+		// d(L, t) <= d(L, s) + d(s, t) and d(s, L) <= d(s, t) + d(t, L)
+		lower = std::max(lower, from_finite ? int64_t(from_t[l]) - from_s[l] : 0);
+		lower = std::max(lower, to_finite ? int64_t(to_s[l]) - to_t[l] : 0);
+
+		// d(s, t) <= d(s, L) + d(L, t)
+		if (to_s[l] != RoutingKit::inf_weight && from_t[l] != RoutingKit::inf_weight)
+		{
+			upper = std::min(upper, uint64_t(to_s[l]) + from_t[l]);
+		}
+	}
+
+	return { unsigned(lower), unsigned(upper) };
+}
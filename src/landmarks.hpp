@@ -0,0 +1,39 @@
+#pragma once
+
+#include "cache_aligned_allocator.hpp"
+#include "phast.hpp"
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <utility>
+#include <vector>
+
+// one PHAST sweep per direction fills the distance tables, and a node's distances fill one cache line
+static const unsigned NUM_LANDMARKS = PHAST_LANES;
+
+// ALT (A*, landmarks, triangle inequality) bounds on shortest path distances. Landmarks are chosen by farthest-point
+// selection: each is the node farthest from the landmarks chosen before it. Distances from and to the landmarks are
+// stored node-major, so the bounds for a pair of nodes read one cache line per node and direction.
+class Landmarks
+{
+public:
+	Landmarks(const RoutingKit::ContractionHierarchy& ch);
+
+	const std::vector<unsigned>& landmarks() const noexcept;
+
+	// max over landmarks L of d(L, t) - d(L, s) and d(s, L) - d(t, L), where both distances are finite
+	unsigned lower_bound(unsigned s, unsigned t) const noexcept;
+
+	// min over landmarks L of d(s, L) + d(L, t); inf_weight if no landmark connects s to t
+	unsigned upper_bound(unsigned s, unsigned t) const noexcept;
+
+	// { lower_bound(s, t), upper_bound(s, t) }
+	std::pair<unsigned, unsigned> bounds(unsigned s, unsigned t) const noexcept;
+
+private:
+	std::vector<unsigned> _landmarks;
+
+	// _from_landmarks[v * NUM_LANDMARKS + l] = d(landmark l, v), and _to_landmarks the other way around
+	std::vector<unsigned, CacheAlignedAllocator<unsigned>> _from_landmarks;
+	std::vector<unsigned, CacheAlignedAllocator<unsigned>> _to_landmarks;
+};
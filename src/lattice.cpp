@@ -1,56 +1,71 @@
 #include "lattice.hpp"
 
-#include <cmath>
 #include <fstream>
 #include <queue>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
-Lattice::Lattice(unsigned side_length, unsigned dimension, bool wrap_around) :
-	Graph(static_cast<unsigned>(std::pow(side_length, dimension)), true),
-	_side_length(side_length), _dimension(dimension)
+namespace
 {
-	std::vector<unsigned> coords(dimension, 0);
-	std::vector<unsigned> new_coords(dimension, 0);
+	void index_to_coords(unsigned index, unsigned side_length, std::vector<unsigned>& coords) noexcept
+	{
+		for (unsigned d = 0; d < coords.size(); ++d)
+		{
+			coords[d] = index % side_length;
+			index /= side_length;
+		}
+	}
 
-	for (unsigned index = 0; index < size(); ++index)
+	unsigned coords_to_index(const std::vector<unsigned>& coords, unsigned side_length) noexcept
 	{
-		index_to_coords(index, coords);
+		unsigned index = 0;
+		for (unsigned d = coords.size() - 1; d < coords.size(); --d)
+		{
+			index = index * side_length + coords[d];
+		}
+		return index;
+	}
+
+	GraphBuilder build_lattice(unsigned side_length, unsigned dimension, bool wrap_around)
+	{
+		unsigned num_nodes = 1;
 		for (unsigned d = 0; d < dimension; ++d)
 		{
-			for (int sign : {-1, 1})
+			num_nodes *= side_length;
+		}
+
+		GraphBuilder builder(num_nodes, true);
+
+		std::vector<unsigned> coords(dimension, 0);
+		std::vector<unsigned> new_coords(dimension, 0);
+
+		for (unsigned index = 0; index < builder.size(); ++index)
+		{
+			index_to_coords(index, side_length, coords);
+			for (unsigned d = 0; d < dimension; ++d)
 			{
-				if (!wrap_around && ((coords[d] == 0 && sign == -1) || (coords[d] == side_length - 1 && sign == 1)))
+				for (int sign : {-1, 1})
 				{
-					continue;
-				}
+					if (!wrap_around && ((coords[d] == 0 && sign == -1) || (coords[d] == side_length - 1 && sign == 1)))
+					{
+						continue;
+					}
 
-				new_coords = coords;
-				new_coords[d] = (new_coords[d] + sign + side_length) % side_length;
-				add_edge(index, coords_to_index(new_coords), 1.0);
+					new_coords = coords;
+					new_coords[d] = (new_coords[d] + sign + side_length) % side_length;
+					builder.add_edge(index, coords_to_index(new_coords, side_length), 1);
+				}
 			}
 		}
-	}
-}
 
-void Lattice::index_to_coords(unsigned index, std::vector<unsigned>& coords) const noexcept
-{
-	for (unsigned d = 0; d < _dimension; ++d)
-	{
-		coords[d] = index % _side_length;
-		index /= _side_length;
+		return builder;
 	}
 }
 
-unsigned Lattice::coords_to_index(const std::vector<unsigned>& coords) const noexcept
+Lattice::Lattice(unsigned side_length, unsigned dimension, bool wrap_around) :
+	Graph(build_lattice(side_length, dimension, wrap_around)),
+	_side_length(side_length), _dimension(dimension)
 {
-	unsigned index = 0;
-	for (unsigned d = _dimension - 1; d < _dimension; --d)
-	{
-		index = index * _side_length + coords[d];
-	}
-	return index;
 }
 
 unsigned Lattice::side_length() const noexcept
@@ -12,10 +12,6 @@ public:
 	unsigned dimension() const noexcept;
 
 private:
-	void index_to_coords(unsigned index, std::vector<unsigned>& coords) const noexcept;
-
-	unsigned coords_to_index(const std::vector<unsigned>& coords) const noexcept;
-
 	unsigned _side_length;
 	unsigned _dimension;
 };
\ No newline at end of file
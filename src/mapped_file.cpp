@@ -0,0 +1,54 @@
+#include "mapped_file.hpp"
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	struct stat status;
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+	{
+		void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			_data = data;
+			_size = status.st_size;
+		}
+	}
+
+	// the mapping outlives the descriptor
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data != nullptr)
+	{
+		munmap(_data, _size);
+	}
+}
+
+bool MappedFile::is_open() const noexcept
+{
+	return _data != nullptr;
+}
+
+const std::byte* MappedFile::data() const noexcept
+{
+	return static_cast<const std::byte*>(_data);
+}
+
+size_t MappedFile::size() const noexcept
+{
+	return _size;
+}
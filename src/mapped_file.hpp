@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A read-only, shared mapping of a whole file. Processes mapping the same file share its page-cache copy.
+class MappedFile
+{
+public:
+	// is_open() is false if the file cannot be opened or mapped
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool is_open() const noexcept;
+
+	const std::byte* data() const noexcept;
+	size_t size() const noexcept;
+
+private:
+	void* _data = nullptr;
+	size_t _size = 0;
+};
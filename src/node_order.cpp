@@ -0,0 +1,201 @@
+#include "node_order.hpp"
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	const unsigned HILBERT_BITS = 16;
+
+	// the index of (x, y) on the Hilbert curve through a 2^HILBERT_BITS x 2^HILBERT_BITS grid
+	uint64_t hilbert_index(uint32_t x, uint32_t y) noexcept
+	{
+		const uint32_t side = uint32_t(1) << HILBERT_BITS;
+
+		uint64_t index = 0;
+		for (uint32_t s = side / 2; s > 0; s /= 2)
+		{
+			uint32_t rx = (x & s) > 0;
+			uint32_t ry = (y & s) > 0;
+			index += uint64_t(s) * s * ((3 * rx) ^ ry);
+
+			// rotate the quadrant, so that the curve inside it starts and ends where it joins its neighbors
+			if (ry == 0)
+			{
+				if (rx == 1)
+				{
+					x = side - 1 - x;
+					y = side - 1 - y;
+				}
+
+				std::swap(x, y);
+			}
+		}
+
+		return index;
+	}
+
+	// maps value from [min, max] onto [0, 2^HILBERT_BITS)
+	uint32_t grid_cell(int32_t value, int32_t min, int32_t max) noexcept
+	{
+		if (max == min)
+		{
+			return 0;
+		}
+
+		return (int64_t(value) - min) * ((int64_t(1) << HILBERT_BITS) - 1) / (int64_t(max) - min);
+	}
+}
+
+const char* to_string(NodeOrdering ordering) noexcept
+{
+	switch (ordering)
+	{
+	case NodeOrdering::BREADTH_FIRST:
+		return "breadth-first";
+	case NodeOrdering::HILBERT:
+		return "Hilbert";
+	case NodeOrdering::CONTRACTION_RANK:
+		return "contraction rank";
+	default:
+		return "original";
+	}
+}
+
+std::vector<unsigned> breadth_first_order(const Graph& graph)
+{
+	unsigned num_nodes = graph.size();
+
+	std::vector<unsigned> order;
+	order.reserve(num_nodes);
+
+	std::vector<bool> is_numbered(num_nodes, false);
+
+	// the search for a pseudo-peripheral node marks what it reaches with the node it started from
+	std::vector<unsigned> reached_from(num_nodes, std::numeric_limits<unsigned>::max());
+	std::vector<unsigned> queue;
+
+	auto degree = [&graph](unsigned u) { return graph.get_neighbors(u).size(); };
+
+	for (unsigned first = 0; first < num_nodes; ++first)
+	{
+		if (is_numbered[first])
+		{
+			continue;
+		}
+
+		queue.assign(1, first);
+		reached_from[first] = first;
+
+		for (unsigned i = 0; i < queue.size(); ++i)
+		{
+			for (unsigned neighbor : graph.get_neighbors(queue[i]).targets())
+			{
+				if (reached_from[neighbor] != first && !is_numbered[neighbor])
+				{
+					reached_from[neighbor] = first;
+					queue.push_back(neighbor);
+				}
+			}
+		}
+
+		unsigned root = queue.back();
+
+		size_t begin = order.size();
+		order.push_back(root);
+		is_numbered[root] = true;
+
+		for (size_t i = begin; i < order.size(); ++i)
+		{
+			size_t first_new = order.size();
+
+			for (unsigned neighbor : graph.get_neighbors(order[i]).targets())
+			{
+				if (!is_numbered[neighbor])
+				{
+					is_numbered[neighbor] = true;
+					order.push_back(neighbor);
+				}
+			}
+
+			std::stable_sort(order.begin() + first_new, order.end(), [&](unsigned a, unsigned b) { return degree(a) < degree(b); });
+		}
+	}
+
+	std::reverse(order.begin(), order.end());
+
+	return order;
+}
+
+std::vector<unsigned> hilbert_order(std::span<const Coordinate> coordinates)
+{
+	int32_t min_longitude = std::numeric_limits<int32_t>::max();
+	int32_t max_longitude = std::numeric_limits<int32_t>::min();
+	int32_t min_latitude = std::numeric_limits<int32_t>::max();
+	int32_t max_latitude = std::numeric_limits<int32_t>::min();
+
+	for (const auto& coordinate : coordinates)
+	{
+		min_longitude = std::min(min_longitude, coordinate.longitude);
+		max_longitude = std::max(max_longitude, coordinate.longitude);
+		min_latitude = std::min(min_latitude, coordinate.latitude);
+		max_latitude = std::max(max_latitude, coordinate.latitude);
+	}
+
+	std::vector<std::pair<uint64_t, unsigned>> indexed(coordinates.size());
+
+	for (unsigned u = 0; u < coordinates.size(); ++u)
+	{
+		uint32_t x = grid_cell(coordinates[u].longitude, min_longitude, max_longitude);
+		uint32_t y = grid_cell(coordinates[u].latitude, min_latitude, max_latitude);
+		indexed[u] = { hilbert_index(x, y), u };
+	}
+
+	std::sort(indexed.begin(), indexed.end());
+
+	std::vector<unsigned> order(coordinates.size());
+	for (unsigned i = 0; i < order.size(); ++i)
+	{
+		order[i] = indexed[i].second;
+	}
+
+	return order;
+}
+
+std::vector<unsigned> invert_order(std::span<const unsigned> order)
+{
+	std::vector<unsigned> position(order.size());
+
+	for (unsigned i = 0; i < order.size(); ++i)
+	{
+		position[order[i]] = i;
+	}
+
+	return position;
+}
+
+RoutingKit::ContractionHierarchy renumber_contraction_hierarchy(RoutingKit::ContractionHierarchy ch, std::span<const unsigned> order, std::span<const unsigned> position)
+{
+	std::vector<unsigned> rank(order.size());
+
+	for (unsigned i = 0; i < order.size(); ++i)
+	{
+		rank[i] = ch.rank[order[i]];
+	}
+
+	for (unsigned& node : ch.order)
+	{
+		node = position[node];
+	}
+
+	ch.rank = std::move(rank);
+
+	return ch;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "coordinates.hpp"
+#include "graph.hpp"
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <span>
+#include <vector>
+
+// An order lists the nodes in their new numbering: order[i] is the node that becomes node i. Its inverse, position,
+// maps a node to its new number, the way a contraction hierarchy's order and rank relate.
+enum class NodeOrdering
+{
+	ORIGINAL,        // the numbering of the source file
+	BREADTH_FIRST,   // reverse Cuthill-McKee: neighbors get nearby numbers, so searches sweep memory in runs
+	HILBERT,         // along a Hilbert curve through the coordinates, so nearby nodes get nearby numbers
+	CONTRACTION_RANK // by contraction hierarchy rank, the order CH searches and PHAST already index their arrays by
+};
+
+const char* to_string(NodeOrdering ordering) noexcept;
+
+// Reverse Cuthill-McKee. Until every node is numbered, a breadth-first search that visits neighbors by increasing
+// degree, from a pseudo-peripheral node: the last one reached from the first unnumbered node. The order is then reversed.
+std::vector<unsigned> breadth_first_order(const Graph& graph);
+
+// the nodes sorted by their index on a 2^16 x 2^16 Hilbert curve over the bounding box of the coordinates
+std::vector<unsigned> hilbert_order(std::span<const Coordinate> coordinates);
+
+std::vector<unsigned> invert_order(std::span<const unsigned> order);
+
+// The same hierarchy over renumbered nodes. Its arcs are indexed by rank, so only rank and order change.
+RoutingKit::ContractionHierarchy renumber_contraction_hierarchy(RoutingKit::ContractionHierarchy ch, std::span<const unsigned> order, std::span<const unsigned> position);
+
+// values indexed by the new numbering, for per-node data like coordinates
+template <typename T>
+std::vector<T> renumber_values(std::span<const T> values, std::span<const unsigned> order)
+{
+	std::vector<T> renumbered(order.size());
+
+	for (unsigned i = 0; i < order.size(); ++i)
+	{
+		renumbered[i] = values[order[i]];
+	}
+
+	return renumbered;
+}
@@ -0,0 +1,61 @@
+#include "original_graph.hpp"
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <vector>
+
+OriginalGraph::OriginalGraph(const RoutingKit::ContractionHierarchy& ch, bool reversed) :
+	first_arc(ch.node_count() + 1, 0)
+{
+	unsigned num_nodes = ch.node_count();
+
+	// forward arcs run from lower to higher rank, backward arcs from higher to lower rank
+	auto for_each_original_arc = [&](auto&& callback)
+	{
+		for (unsigned x = 0; x < num_nodes; ++x)
+		{
+			for (unsigned arc = ch.forward.first_out[x]; arc < ch.forward.first_out[x + 1]; ++arc)
+			{
+				if (ch.forward.is_shortcut_an_original_arc.is_set(arc))
+				{
+					callback(ch.order[x], ch.order[ch.forward.head[arc]], ch.forward.weight[arc]);
+				}
+			}
+
+			for (unsigned arc = ch.backward.first_out[x]; arc < ch.backward.first_out[x + 1]; ++arc)
+			{
+				if (ch.backward.is_shortcut_an_original_arc.is_set(arc))
+				{
+					callback(ch.order[ch.backward.head[arc]], ch.order[x], ch.backward.weight[arc]);
+				}
+			}
+		}
+	};
+
+	for_each_original_arc([&](unsigned u, unsigned v, unsigned)
+	{
+		++first_arc[(reversed ? v : u) + 1];
+	});
+
+	for (unsigned v = 0; v < num_nodes; ++v)
+	{
+		first_arc[v + 1] += first_arc[v];
+	}
+
+	other_end.resize(first_arc[num_nodes]);
+	weight.resize(first_arc[num_nodes]);
+	std::vector<unsigned> next(first_arc.begin(), first_arc.end() - 1);
+
+	for_each_original_arc([&](unsigned u, unsigned v, unsigned w)
+	{
+		unsigned owner = reversed ? v : u;
+		other_end[next[owner]] = reversed ? u : v;
+		weight[next[owner]] = w;
+		++next[owner];
+	});
+}
+
+unsigned OriginalGraph::size() const noexcept
+{
+	return first_arc.size() - 1;
+}
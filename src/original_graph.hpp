@@ -0,0 +1,18 @@
+#pragma once
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <vector>
+
+// Arcs of the original graph, recovered from the non-shortcut arcs of a contraction hierarchy.
+// Arcs are grouped by tail (other_end is the head) or, if reversed, by head (other_end is the tail).
+struct OriginalGraph
+{
+	OriginalGraph(const RoutingKit::ContractionHierarchy& ch, bool reversed);
+
+	unsigned size() const noexcept;
+
+	std::vector<unsigned> first_arc;
+	std::vector<unsigned> other_end;
+	std::vector<unsigned> weight;
+};
@@ -0,0 +1,131 @@
+#include "phast.hpp"
+
+#include <routingkit/constants.h>
+#include <routingkit/contraction_hierarchy.h>
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <span>
+#include <vector>
+
+#include <immintrin.h>
+
+namespace
+{
+	// half of the unsigned range, so that unreached + weight never wraps around inside the sweep
+	const unsigned UNREACHED = std::numeric_limits<unsigned>::max() / 2;
+
+	// distance[lane] = min(distance[lane], parent_distance[lane] + weight) for every lane
+	template <unsigned LANES>
+	inline void relax(unsigned* distance, const unsigned* parent_distance, unsigned weight) noexcept
+	{
+#if defined(__AVX512F__)
+		if constexpr (LANES % 16 == 0)
+		{
+			__m512i w = _mm512_set1_epi32(weight);
+			for (unsigned lane = 0; lane < LANES; lane += 16)
+			{
+				__m512i d = _mm512_loadu_si512(distance + lane);
+				__m512i p = _mm512_loadu_si512(parent_distance + lane);
+				_mm512_storeu_si512(distance + lane, _mm512_min_epu32(d, _mm512_add_epi32(p, w)));
+			}
+			return;
+		}
+#endif
+#if defined(__AVX2__)
+		if constexpr (LANES % 8 == 0)
+		{
+			__m256i w = _mm256_set1_epi32(weight);
+			for (unsigned lane = 0; lane < LANES; lane += 8)
+			{
+				__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(distance + lane));
+				__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(parent_distance + lane));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(distance + lane), _mm256_min_epu32(d, _mm256_add_epi32(p, w)));
+			}
+			return;
+		}
+#endif
+		for (unsigned lane = 0; lane < LANES; ++lane)
+		{
+			distance[lane] = std::min(distance[lane], parent_distance[lane] + weight);
+		}
+	}
+}
+
+PHAST::PHAST(const RoutingKit::ContractionHierarchy& ch, Direction direction) :
+	_contraction_hierarchy(ch),
+	_upward(direction == Direction::FROM_SOURCES ? ch.forward : ch.backward),
+	_downward(direction == Direction::FROM_SOURCES ? ch.backward : ch.forward)
+{
+}
+
+unsigned PHAST::node_count() const noexcept
+{
+	return _contraction_hierarchy.node_count();
+}
+
+unsigned PHAST::rank(unsigned node) const noexcept
+{
+	return _contraction_hierarchy.rank[node];
+}
+
+template <unsigned LANES>
+void PHAST::run(std::span<const unsigned, LANES> sources, std::vector<unsigned>& distances) const noexcept
+{
+	unsigned num_nodes = node_count();
+	distances.assign(size_t(num_nodes) * LANES, UNREACHED);
+
+	// upward searches, one lane at a time
+	std::priority_queue<std::pair<unsigned, unsigned>, std::vector<std::pair<unsigned, unsigned>>, std::greater<>> queue;
+
+	for (unsigned lane = 0; lane < LANES; ++lane)
+	{
+		unsigned source = rank(sources[lane]);
+		distances[size_t(source) * LANES + lane] = 0;
+		queue.push({0, source});
+
+		while (!queue.empty())
+		{
+			auto [distance, node] = queue.top();
+			queue.pop();
+
+			if (distance > distances[size_t(node) * LANES + lane])
+			{
+				continue;
+			}
+
+			for (unsigned arc = _upward.first_out[node]; arc < _upward.first_out[node + 1]; ++arc)
+			{
+				unsigned& head_distance = distances[size_t(_upward.head[arc]) * LANES + lane];
+				unsigned new_distance = distance + _upward.weight[arc];
+
+				if (new_distance < head_distance)
+				{
+					head_distance = new_distance;
+					queue.push({new_distance, _upward.head[arc]});
+				}
+			}
+		}
+	}
+
+	// downward sweep: every arc of the other side leads from a node to a higher ranked one that is already final
+	for (unsigned node = num_nodes; node-- > 0;)
+	{
+		unsigned* node_distances = distances.data() + size_t(node) * LANES;
+
+		for (unsigned arc = _downward.first_out[node]; arc < _downward.first_out[node + 1]; ++arc)
+		{
+			relax<LANES>(node_distances, distances.data() + size_t(_downward.head[arc]) * LANES, _downward.weight[arc]);
+		}
+	}
+
+	for (unsigned& distance : distances)
+	{
+		distance = distance >= UNREACHED ? RoutingKit::inf_weight : distance;
+	}
+}
+
+template void PHAST::run<1>(std::span<const unsigned, 1>, std::vector<unsigned>&) const noexcept;
+template void PHAST::run<8>(std::span<const unsigned, 8>, std::vector<unsigned>&) const noexcept;
+template void PHAST::run<16>(std::span<const unsigned, 16>, std::vector<unsigned>&) const noexcept;
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <routingkit/contraction_hierarchy.h>
+
+#include <span>
+#include <vector>
+
+// sources per sweep that fill one AVX-512 register
+static const unsigned PHAST_LANES = 16;
+
+// PHAST one-to-all distances over a contraction hierarchy: an upward search from each source,
+// then one linear sweep over the downward arcs in decreasing rank order.
+// Up to 16 sources share a sweep, each in its own SIMD lane (AVX-512 or AVX2, with a scalar fallback).
+class PHAST
+{
+public:
+	enum class Direction
+	{
+		FROM_SOURCES,
+		TO_TARGETS
+	};
+
+	PHAST(const RoutingKit::ContractionHierarchy& ch, Direction direction = Direction::FROM_SOURCES);
+
+	unsigned node_count() const noexcept;
+
+	// distances is indexed by CH rank with the lanes interleaved: distances[rank * LANES + lane];
+	// unreachable nodes get inf_weight
+	template <unsigned LANES>
+	void run(std::span<const unsigned, LANES> sources, std::vector<unsigned>& distances) const noexcept;
+
+	unsigned rank(unsigned node) const noexcept;
+
+private:
+	const RoutingKit::ContractionHierarchy& _contraction_hierarchy;
+	const RoutingKit::ContractionHierarchy::Side& _upward;
+	const RoutingKit::ContractionHierarchy::Side& _downward;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+// What a Philox stream is drawing, so that different uses of one (seed, batch, index) never share numbers
+enum class RandomStream : uint32_t
+{
+	HIGHWAY_NODES,
+	FROZEN_CONTACTS,
+	TRIAL_ENDPOINTS,
+	RESAMPLED_CONTACTS
+};
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Every (seed, stream, batch, index) names its own independent sequence, so a draw does not depend on
+// which thread makes it or on what was drawn before it: runs are reproducible for any thread count, and
+// evaluations that share a seed see common random numbers.
+class Philox
+{
+public:
+	using result_type = uint32_t;
+
+	Philox(uint64_t seed, RandomStream stream, uint32_t batch, uint32_t index) noexcept :
+		_key{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) },
+		_counter{ 0, index, batch, static_cast<uint32_t>(stream) }
+	{
+	}
+
+	static constexpr result_type min() noexcept
+	{
+		return 0;
+	}
+
+	static constexpr result_type max() noexcept
+	{
+		return std::numeric_limits<result_type>::max();
+	}
+
+	result_type operator()() noexcept
+	{
+		if (_position == _output.size())
+		{
+			_output = generate(_counter, _key);
+			++_counter[0];
+			_position = 0;
+		}
+
+		return _output[_position++];
+	}
+
+	static std::array<uint32_t, 4> generate(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) noexcept
+	{
+		for (unsigned round = 0; round < 10; ++round)
+		{
+			uint64_t product0 = uint64_t(0xD2511F53) * counter[0];
+			uint64_t product1 = uint64_t(0xCD9E8D57) * counter[2];
+
+			counter = {
+				static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+				static_cast<uint32_t>(product1),
+				static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+				static_cast<uint32_t>(product0)
+			};
+
+			key[0] += 0x9E3779B9;
+			key[1] += 0xBB67AE85;
+		}
+
+		return counter;
+	}
+
+private:
+	std::array<uint32_t, 2> _key;
+	std::array<uint32_t, 4> _counter;
+	std::array<uint32_t, 4> _output;
+	unsigned _position = 4;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Monotone priority queue for unsigned keys (Ahuja et al., "Faster algorithms for the shortest path problem").
+// Keys pushed must be at least the last key popped, as in Dijkstra's algorithm with non-negative integer weights.
+// Bucket i holds the keys whose highest bit differing from the last popped key is bit i - 1, so every element
+// moves to a lower bucket at most 32 times: O(log C) amortized per operation, with plain vectors for buckets.
+template <typename Value>
+class RadixHeap
+{
+public:
+	void push(unsigned key, Value value)
+	{
+		_buckets[bucket(key)].push_back({ key, value });
+		++_size;
+	}
+
+	// the element with the smallest key
+	std::pair<unsigned, Value> pop()
+	{
+		refill();
+
+		auto element = _buckets[0].back();
+		_buckets[0].pop_back();
+		--_size;
+
+		return element;
+	}
+
+	// the smallest key, without popping its element
+	unsigned min_key()
+	{
+		refill();
+
+		return _buckets[0].back().first;
+	}
+
+	bool empty() const noexcept
+	{
+		return _size == 0;
+	}
+
+	// keeps the buckets' capacity
+	void clear() noexcept
+	{
+		for (auto& bucket : _buckets)
+		{
+			bucket.clear();
+		}
+
+		_last = 0;
+		_size = 0;
+	}
+
+private:
+	// moves the elements with the smallest key into bucket 0, unless it already holds some
+	void refill()
+	{
+		if (!_buckets[0].empty())
+		{
+			return;
+		}
+
+		unsigned i = 1;
+		while (_buckets[i].empty())
+		{
+			++i;
+		}
+
+		unsigned smallest = std::numeric_limits<unsigned>::max();
+		for (const auto& [key, value] : _buckets[i])
+		{
+			smallest = std::min(smallest, key);
+		}
+
+		// everything in bucket i now shares more leading bits with the new last key, so it moves down
+		_last = smallest;
+		for (const auto& element : _buckets[i])
+		{
+			_buckets[bucket(element.first)].push_back(element);
+		}
+
+		_buckets[i].clear();
+	}
+
+	unsigned bucket(unsigned key) const noexcept
+	{
+		return std::bit_width(key ^ _last);
+	}
+
+	std::array<std::vector<std::pair<unsigned, Value>>, std::numeric_limits<unsigned>::digits + 1> _buckets;
+	unsigned _last = 0;
+	size_t _size = 0;
+};
@@ -1,13 +1,31 @@
 #include "road_networks.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <numeric>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 #include <routingkit/contraction_hierarchy.h>
 
+#include <stdio.h>
+
+// the RoutingKit commit, passed in by the Makefile; hierarchies built by another RoutingKit are rebuilt
+#ifndef ROUTINGKIT_VERSION
+#define ROUTINGKIT_VERSION "unknown"
+#endif
+
 namespace
 {
 	std::vector<std::string> get_names(bool is_state)
@@ -21,7 +39,9 @@ namespace
 				continue;
 			}
 
-			if (entry.path().extension().compare(RAW_NETWORK_EXTENSION))
+			// a network may come as both a .raw file and DIMACS files
+			auto extension = entry.path().extension();
+			if (extension != RAW_NETWORK_EXTENSION && extension != DIMACS_GRAPH_EXTENSION)
 			{
 				continue;
 			}
@@ -35,8 +55,244 @@ namespace
 			names.emplace_back(stem);
 		}
 
+		std::sort(names.begin(), names.end());
+		names.erase(std::unique(names.begin(), names.end()), names.end());
+
 		return names;
 	}
+
+	const char* skip_blanks(const char* p, const char* end) noexcept
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		{
+			++p;
+		}
+
+		return p;
+	}
+
+	const char* skip_line(const char* p, const char* end) noexcept
+	{
+		const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		return newline == nullptr ? end : newline + 1;
+	}
+
+	// identifies what a cached contraction hierarchy was built from; the .ch file itself is RoutingKit's own format
+	struct ContractionHierarchyHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		uint64_t graph_hash;
+		char routingkit_version[48];
+
+		bool operator==(const ContractionHierarchyHeader&) const = default;
+	};
+
+	ContractionHierarchyHeader make_contraction_hierarchy_header(const Graph& graph)
+	{
+		ContractionHierarchyHeader header{};
+		std::memcpy(header.magic, "FGRCHHDR", sizeof(header.magic));
+		header.version = CONTRACTION_HIERARCHY_HEADER_VERSION;
+		header.graph_hash = graph.content_hash();
+		std::strncpy(header.routingkit_version, ROUTINGKIT_VERSION, sizeof(header.routingkit_version) - 1);
+
+		return header;
+	}
+
+	bool read_contraction_hierarchy_header(const std::string& header_file, ContractionHierarchyHeader& header)
+	{
+		std::ifstream file(header_file, std::ios::binary);
+		return bool(file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+	}
+
+	bool has_current_contraction_hierarchy(const Graph& graph, const std::string& header_file)
+	{
+		ContractionHierarchyHeader header;
+		return read_contraction_hierarchy_header(header_file, header) && header == make_contraction_hierarchy_header(graph);
+	}
+
+	// loads the contraction hierarchy of graph cached in ch_file, or builds and caches it
+	RoutingKit::ContractionHierarchy get_contraction_hierarchy(const Graph& graph, const std::string& ch_file, const std::string& header_file)
+	{
+		auto expected_header = make_contraction_hierarchy_header(graph);
+
+		// the cached contraction hierarchy is only used if it was built from this graph by this RoutingKit
+		ContractionHierarchyHeader header;
+		if (read_contraction_hierarchy_header(header_file, header) && header == expected_header && std::filesystem::exists(ch_file))
+		{
+			return RoutingKit::ContractionHierarchy::load_file(ch_file);
+		}
+
+		// if not, build it from the deduplicated CSR graph
+		auto ch = graph.get_contraction_hierarchy();
+
+		// the header goes last, so that an interrupted save leaves a mismatch rather than a stale match
+		ch.save_file(ch_file + ".tmp");
+		std::filesystem::rename(ch_file + ".tmp", ch_file);
+
+		{
+			std::ofstream file(header_file + ".tmp", std::ios::binary);
+			file.write(reinterpret_cast<const char*>(&expected_header), sizeof(expected_header));
+		}
+		std::filesystem::rename(header_file + ".tmp", header_file);
+
+		return ch;
+	}
+
+	// 32 bytes, followed by the order
+	struct NodeOrderHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t ordering;
+		uint64_t graph_hash;
+		uint64_t num_nodes;
+
+		bool operator==(const NodeOrderHeader&) const = default;
+	};
+
+	NodeOrderHeader make_node_order_header(const Graph& graph, NodeOrdering ordering)
+	{
+		NodeOrderHeader header{};
+		std::memcpy(header.magic, "FGRORDER", sizeof(header.magic));
+		header.version = NODE_ORDER_VERSION;
+		header.ordering = unsigned(ordering);
+		header.graph_hash = graph.content_hash();
+		header.num_nodes = graph.size();
+
+		return header;
+	}
+
+	// the cached order if it matches the expected header, otherwise one computed and saved by compute_order
+	template <typename ComputeOrder>
+	std::vector<unsigned> get_node_order(const std::string& name, const Graph& graph, NodeOrdering ordering, ComputeOrder&& compute_order)
+	{
+		if (ordering == NodeOrdering::ORIGINAL)
+		{
+			std::vector<unsigned> order(graph.size());
+			std::iota(order.begin(), order.end(), 0);
+			return order;
+		}
+
+		auto expected_header = make_node_order_header(graph, ordering);
+		std::string order_file = ROAD_NETWORK_DIRECTORY + name + NODE_ORDER_EXTENSION;
+
+		{
+			std::ifstream file(order_file, std::ios::binary);
+			NodeOrderHeader header;
+			std::vector<unsigned> order(graph.size());
+
+			if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) && header == expected_header &&
+				file.read(reinterpret_cast<char*>(order.data()), order.size() * sizeof(unsigned)))
+			{
+				return order;
+			}
+		}
+
+		std::vector<unsigned> order = compute_order();
+
+		{
+			std::ofstream file(order_file + ".tmp", std::ios::binary);
+			file.write(reinterpret_cast<const char*>(&expected_header), sizeof(expected_header));
+			file.write(reinterpret_cast<const char*>(order.data()), order.size() * sizeof(unsigned));
+		}
+		std::filesystem::rename(order_file + ".tmp", order_file);
+
+		return order;
+	}
+
+	unsigned num_parse_chunks(const char* begin, const char* end) noexcept
+	{
+		return (size_t(end - begin) + RAW_PARSE_CHUNK_SIZE - 1) / RAW_PARSE_CHUNK_SIZE;
+	}
+
+	// calls parse_line on the start of every line that starts in [begin, end); file_end bounds the last line
+	template <typename ParseLine>
+	void parse_lines(const char* begin, const char* end, const char* file_end, ParseLine&& parse_line)
+	{
+		for (const char* line = begin; line < end; line = skip_line(line, file_end))
+		{
+			parse_line(skip_blanks(line, file_end));
+		}
+	}
+
+	// Calls parse_chunk(chunk, first_line, end) on the thread pool for every RAW_PARSE_CHUNK_SIZE-byte chunk of
+	// [begin, end). A line belongs to the chunk its first byte is in, so each chunk starts after the newline before it.
+	template <typename ParseChunk>
+	void parse_chunks(const char* begin, const char* end, ParseChunk&& parse_chunk)
+	{
+		size_t num_bytes = end - begin;
+
+		ThreadPool::instance().parallel_for(num_parse_chunks(begin, end), 1, [&](unsigned first, unsigned last, unsigned)
+		{
+			for (unsigned chunk = first; chunk < last; ++chunk)
+			{
+				const char* chunk_begin = begin + chunk * RAW_PARSE_CHUNK_SIZE;
+				const char* chunk_end = begin + std::min(num_bytes, (chunk + 1) * RAW_PARSE_CHUNK_SIZE);
+
+				if (chunk > 0 && chunk_begin[-1] != '\n')
+				{
+					chunk_begin = skip_line(chunk_begin, end);
+				}
+
+				parse_chunk(chunk, chunk_begin, chunk_end);
+			}
+		});
+	}
+
+	// parses the edges of the chunks into one builder each, then merges them
+	template <typename ParseEdge>
+	Graph parse_edges(unsigned num_nodes, bool directed, const char* begin, const char* end, ParseEdge&& parse_edge)
+	{
+		std::vector<GraphBuilder> chunks(num_parse_chunks(begin, end), GraphBuilder(num_nodes, directed));
+
+		parse_chunks(begin, end, [&](unsigned chunk, const char* chunk_begin, const char* chunk_end)
+		{
+			parse_lines(chunk_begin, chunk_end, end, [&](const char* line) { parse_edge(line, chunks[chunk]); });
+		});
+
+		GraphBuilder builder(num_nodes, directed);
+		for (auto& chunk : chunks)
+		{
+			builder.append(std::move(chunk));
+		}
+
+		return Graph(std::move(builder));
+	}
+
+	// the node count of a DIMACS problem line ("p sp n m" or "p aux sp co n"), which is its first number;
+	// the lines after it start at body
+	unsigned parse_dimacs_problem_line(const char* data, const char* end, const char*& body) noexcept
+	{
+		const char* line = skip_blanks(data, end);
+		while (line < end && *line != 'p')
+		{
+			line = skip_blanks(skip_line(line, end), end);
+		}
+
+		body = skip_line(line, end);
+		if (line == end)
+		{
+			return 0;
+		}
+
+		for (const char* token = skip_blanks(line + 1, end); token < body && *token != '\n'; token = skip_blanks(token, end))
+		{
+			unsigned num_nodes;
+			if (std::from_chars(token, body, num_nodes).ec == std::errc())
+			{
+				return num_nodes;
+			}
+
+			while (token < body && !std::isspace(static_cast<unsigned char>(*token)))
+			{
+				++token;
+			}
+		}
+
+		return 0;
+	}
 }
 
 std::vector<std::string> get_state_names()
@@ -49,58 +305,222 @@ std::vector<std::string> get_non_state_names()
 	return get_names(false);
 }
 
-Graph get_graph(const std::string& name)
+Graph parse_raw_graph(const std::string& path)
 {
-	std::ifstream file(ROAD_NETWORK_DIRECTORY + name + RAW_NETWORK_EXTENSION);
+	MappedFile file(path);
+	if (!file.is_open())
+	{
+		return Graph(GraphBuilder(0));
+	}
+
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* data_end = data + file.size();
 
-	unsigned num_nodes;
-	file >> num_nodes;
+	unsigned num_nodes = 0;
+	auto [header_end, error] = std::from_chars(skip_blanks(data, data_end), data_end, num_nodes);
 
-	Graph g(num_nodes);
+	return parse_edges(num_nodes, false, skip_line(header_end, data_end), data_end, [data_end](const char* line, GraphBuilder& builder)
+	{
+		unsigned u, v;
+		double weight;
+
+		auto [u_end, u_error] = std::from_chars(line, data_end, u);
+		auto [v_end, v_error] = std::from_chars(skip_blanks(u_end, data_end), data_end, v);
+		auto [weight_end, weight_error] = std::from_chars(skip_blanks(v_end, data_end), data_end, weight);
+
+		// lines that do not parse are skipped
+		if (u_error == std::errc() && v_error == std::errc() && weight_error == std::errc())
+		{
+			builder.add_edge(u, v, std::lround(weight));
+		}
+	});
+}
 
-	unsigned u, v;
-	double weight;
-	while (file >> u >> v >> weight)
+Graph parse_dimacs_graph(const std::string& path)
+{
+	MappedFile file(path);
+	if (!file.is_open())
 	{
-		g.add_edge(u, v, std::lround(weight));
+		return Graph(GraphBuilder(0));
 	}
 
-	return g;
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* data_end = data + file.size();
+
+	const char* arcs;
+	unsigned num_nodes = parse_dimacs_problem_line(data, data_end, arcs);
+
+	return parse_edges(num_nodes, true, arcs, data_end, [data_end, num_nodes](const char* line, GraphBuilder& builder)
+	{
+		if (*line != 'a')
+		{
+			return;
+		}
+
+		unsigned u, v, weight;
+
+		auto [u_end, u_error] = std::from_chars(skip_blanks(line + 1, data_end), data_end, u);
+		auto [v_end, v_error] = std::from_chars(skip_blanks(u_end, data_end), data_end, v);
+		auto [weight_end, weight_error] = std::from_chars(skip_blanks(v_end, data_end), data_end, weight);
+
+		if (u_error == std::errc() && v_error == std::errc() && weight_error == std::errc() && u - 1 < num_nodes && v - 1 < num_nodes)
+		{
+			builder.add_edge(u - 1, v - 1, weight);
+		}
+	});
 }
 
-RoutingKit::ContractionHierarchy get_contraction_hierarchy(const std::string& name)
+std::vector<Coordinate> parse_dimacs_coordinates(const std::string& path)
 {
-	// check if contraction hierarchy is cached
-	std::string ch_file = ROAD_NETWORK_DIRECTORY + name + CONTRACTION_HIERARCHY_NETWORK_EXTENSION;
-	if (std::filesystem::exists(ch_file))
+	MappedFile file(path);
+	if (!file.is_open())
 	{
-		return RoutingKit::ContractionHierarchy::load_file(ch_file);
+		return {};
 	}
 
-	// if not, build it
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* data_end = data + file.size();
+
+	const char* nodes;
+	unsigned num_nodes = parse_dimacs_problem_line(data, data_end, nodes);
+
+	// every node appears on one line, so the chunks write disjoint entries
+	std::vector<Coordinate> coordinates(num_nodes, Coordinate{ 0, 0 });
+
+	parse_chunks(nodes, data_end, [&](unsigned, const char* chunk_begin, const char* chunk_end)
+	{
+		parse_lines(chunk_begin, chunk_end, data_end, [&](const char* line)
+		{
+			if (*line != 'v')
+			{
+				return;
+			}
+
+			unsigned id;
+			int32_t longitude, latitude;
+
+			auto [id_end, id_error] = std::from_chars(skip_blanks(line + 1, data_end), data_end, id);
+			auto [longitude_end, longitude_error] = std::from_chars(skip_blanks(id_end, data_end), data_end, longitude);
+			auto [latitude_end, latitude_error] = std::from_chars(skip_blanks(longitude_end, data_end), data_end, latitude);
+
+			if (id_error == std::errc() && longitude_error == std::errc() && latitude_error == std::errc() && id - 1 < num_nodes)
+			{
+				coordinates[id - 1] = { longitude, latitude };
+			}
+		});
+	});
+
+	return coordinates;
+}
+
+Graph get_graph(const std::string& name)
+{
 	std::string raw_file = ROAD_NETWORK_DIRECTORY + name + RAW_NETWORK_EXTENSION;
-	std::ifstream file(raw_file);
+	std::string source_file = std::filesystem::exists(raw_file) ? raw_file : ROAD_NETWORK_DIRECTORY + name + DIMACS_GRAPH_EXTENSION;
+	std::string graph_file = ROAD_NETWORK_DIRECTORY + name + GRAPH_NETWORK_EXTENSION;
 
-	std::vector<unsigned> tail, head, dist;
-	unsigned u, v, num_nodes;
-	double weight;
+	bool has_source = std::filesystem::exists(source_file);
 
-	file >> num_nodes;
+	// a source edited after the conversion makes the binary graph stale; without a source, whatever was cached is used
+	bool is_current = std::filesystem::exists(graph_file) && (!has_source || std::filesystem::last_write_time(source_file) <= std::filesystem::last_write_time(graph_file));
 
-	while (file >> u >> v >> weight)
+	if (is_current)
 	{
-		head.push_back(u);
-		tail.push_back(v);
-		dist.push_back(std::lround(weight));
+		if (auto graph = Graph::load_file(graph_file))
+		{
+			return std::move(*graph);
+		}
+	}
+
+	if (!has_source)
+	{
+		throw std::runtime_error("road network " + name + " not found: " + source_file + " does not exist, nor does " + raw_file + ", and " + graph_file + " is missing or of an old version");
+	}
+
+	auto graph = source_file == raw_file ? parse_raw_graph(raw_file) : parse_dimacs_graph(source_file);
+	graph.save_file(graph_file);
+
+	return graph;
+}
+
+std::vector<Coordinate> get_coordinates(const std::string& name)
+{
+	return parse_dimacs_coordinates(ROAD_NETWORK_DIRECTORY + name + DIMACS_COORDINATE_EXTENSION);
+}
+
+bool has_current_contraction_hierarchy(const std::string& name)
+{
+	return has_current_contraction_hierarchy(get_graph(name), ROAD_NETWORK_DIRECTORY + name + CONTRACTION_HIERARCHY_HEADER_EXTENSION);
+}
+
+RoutingKit::ContractionHierarchy get_contraction_hierarchy(const std::string& name)
+{
+	std::string path = ROAD_NETWORK_DIRECTORY + name;
+	return get_contraction_hierarchy(get_graph(name), path + CONTRACTION_HIERARCHY_NETWORK_EXTENSION, path + CONTRACTION_HIERARCHY_HEADER_EXTENSION);
+}
 
-		head.push_back(v);
-		tail.push_back(u);
-		dist.push_back(std::lround(weight));
+ChainCompression get_chain_compression(const std::string& name)
+{
+	return ChainCompression(get_graph(name));
+}
+
+bool has_current_core_contraction_hierarchy(const std::string& name)
+{
+	ChainCompression compression(get_graph(name));
+
+	if (compression.num_core_nodes() == compression.size())
+	{
+		return has_current_contraction_hierarchy(name);
 	}
 
-	auto ch = RoutingKit::ContractionHierarchy::build(num_nodes, tail, head, dist);
+	return has_current_contraction_hierarchy(compression.core(), ROAD_NETWORK_DIRECTORY + name + CORE_CONTRACTION_HIERARCHY_HEADER_EXTENSION);
+}
+
+RoutingKit::ContractionHierarchy get_core_contraction_hierarchy(const std::string& name, const ChainCompression& compression)
+{
+	// with nothing to compress, the core is the graph itself
+	if (compression.num_core_nodes() == compression.size())
+	{
+		return get_contraction_hierarchy(name);
+	}
+
+	std::string path = ROAD_NETWORK_DIRECTORY + name;
+	return get_contraction_hierarchy(compression.core(), path + CORE_CONTRACTION_HIERARCHY_NETWORK_EXTENSION, path + CORE_CONTRACTION_HIERARCHY_HEADER_EXTENSION);
+}
+
+std::vector<unsigned> get_node_order(const std::string& name, NodeOrdering ordering)
+{
+	auto graph = get_graph(name);
+
+	return get_node_order(name, graph, ordering, [&]() -> std::vector<unsigned>
+	{
+		if (ordering == NodeOrdering::CONTRACTION_RANK)
+		{
+			return get_contraction_hierarchy(name).order;
+		}
+
+		if (ordering == NodeOrdering::HILBERT)
+		{
+			auto coordinates = get_coordinates(name);
+			if (coordinates.size() == graph.size())
+			{
+				return hilbert_order(coordinates);
+			}
+
+			printf("%s has no coordinates for its %u nodes, ordering it breadth-first\n", name.c_str(), graph.size());
+		}
+
+		return breadth_first_order(graph);
+	});
+}
+
+RenumberedNetwork get_renumbered_network(const std::string& name, NodeOrdering ordering)
+{
+	auto graph = get_graph(name);
+	auto ch = get_contraction_hierarchy(name);
 
-	ch.save_file(ch_file);
+	auto order = get_node_order(name, ordering);
+	auto position = invert_order(order);
 
-	return ch;
+	return { graph.renumbered(order), renumber_contraction_hierarchy(std::move(ch), order, position), std::move(order), std::move(position) };
 }
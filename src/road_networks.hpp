@@ -1,6 +1,9 @@
 #pragma once
 
+#include "chain_compression.hpp"
+#include "coordinates.hpp"
 #include "graph.hpp"
+#include "node_order.hpp"
 
 #include <string>
 #include <vector>
@@ -10,10 +13,76 @@
 static const std::string ROAD_NETWORK_DIRECTORY = "road_networks/";
 static const std::string RAW_NETWORK_EXTENSION = ".raw";
 static const std::string CONTRACTION_HIERARCHY_NETWORK_EXTENSION = ".ch";
+static const std::string CONTRACTION_HIERARCHY_HEADER_EXTENSION = ".ch.header";
+static const std::string CORE_CONTRACTION_HIERARCHY_NETWORK_EXTENSION = ".core.ch";
+static const std::string CORE_CONTRACTION_HIERARCHY_HEADER_EXTENSION = ".core.ch.header";
+static const std::string GRAPH_NETWORK_EXTENSION = ".graph";
+static const std::string DIMACS_GRAPH_EXTENSION = ".gr";
+static const std::string DIMACS_COORDINATE_EXTENSION = ".co";
+static const std::string NODE_ORDER_EXTENSION = ".order";
 
 std::vector<std::string> get_state_names();
 std::vector<std::string> get_non_state_names();
 
+// bumped whenever the layout of contraction hierarchy headers changes
+static const unsigned CONTRACTION_HIERARCHY_HEADER_VERSION = 1;
+
+// bumped whenever the layout of node order files changes
+static const unsigned NODE_ORDER_VERSION = 1;
+
+// bytes of a .raw file per parallel parsing chunk
+static const size_t RAW_PARSE_CHUNK_SIZE = size_t(1) << 20;
+
+// Parses a .raw edge list (the node count, then one "u v weight" line per edge). The file is mapped and split
+// into newline-aligned chunks that are parsed on the thread pool with std::from_chars.
+Graph parse_raw_graph(const std::string& path);
+
+// Reads a DIMACS shortest-path graph (the "p sp n m" line, then one "a u v weight" line per arc) as a directed
+// Graph, numbering its 1-based nodes from 0. Parsed in chunks like parse_raw_graph.
+Graph parse_dimacs_graph(const std::string& path);
+
+// the positions in a DIMACS .co file ("v id longitude latitude" lines), indexed like parse_dimacs_graph's nodes
+std::vector<Coordinate> parse_dimacs_coordinates(const std::string& path);
+
+// maps the cached binary graph, converting the .raw edge list (or, without one, the DIMACS .gr file)
+// into one first if it is missing, of an old version, or older than the source; throws std::runtime_error if there
+// is neither a usable cached graph nor a source
 Graph get_graph(const std::string& name);
 
+// the node positions of a network that comes with a DIMACS .co file; empty otherwise
+std::vector<Coordinate> get_coordinates(const std::string& name);
+
+// whether the cached contraction hierarchy's header matches the current graph's content hash and RoutingKit version
+bool has_current_contraction_hierarchy(const std::string& name);
+
+// loads the cached contraction hierarchy, rebuilding it (and its header) if it is missing or does not match the graph
 RoutingKit::ContractionHierarchy get_contraction_hierarchy(const std::string& name);
+
+// the network's degree-2 chains contracted; built from the graph in linear time, so it is not cached
+ChainCompression get_chain_compression(const std::string& name);
+
+// whether the cached contraction hierarchy of the network's core matches it, as has_current_contraction_hierarchy
+bool has_current_core_contraction_hierarchy(const std::string& name);
+
+// The contraction hierarchy of compression.core(), cached in a .core.ch file with its own header, like the network's.
+// If nothing was compressed, the core is the graph itself, and this is get_contraction_hierarchy(name).
+RoutingKit::ContractionHierarchy get_core_contraction_hierarchy(const std::string& name, const ChainCompression& compression);
+
+// The network's nodes in the given ordering, cached in a .order file next to the contraction hierarchy and recomputed
+// if it was made for another graph or ordering. HILBERT needs coordinates and falls back to BREADTH_FIRST without them.
+std::vector<unsigned> get_node_order(const std::string& name, NodeOrdering ordering);
+
+// A road network renumbered for locality. Everything inside works on the new numbers; order and position translate
+// to and from the numbers of get_graph(name) (and of get_coordinates(name)) wherever node ids cross the boundary.
+struct RenumberedNetwork
+{
+	Graph graph;
+	RoutingKit::ContractionHierarchy contraction_hierarchy;
+
+	// order[i] is the original number of node i, position[u] the new number of original node u
+	std::vector<unsigned> order;
+	std::vector<unsigned> position;
+};
+
+// the graph renumbered, and the cached contraction hierarchy with it; no hierarchy is rebuilt
+RenumberedNetwork get_renumbered_network(const std::string& name, NodeOrdering ordering);
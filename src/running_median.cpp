@@ -0,0 +1,39 @@
+#include "running_median.hpp"
+
+void RunningMedian::add(double x)
+{
+	if (_lower.empty() || x <= _lower.top())
+	{
+		_lower.push(x);
+	}
+	else
+	{
+		_upper.push(x);
+	}
+
+	if (_lower.size() > _upper.size() + 1)
+	{
+		_upper.push(_lower.top());
+		_lower.pop();
+	}
+	else if (_upper.size() > _lower.size())
+	{
+		_lower.push(_upper.top());
+		_upper.pop();
+	}
+}
+
+unsigned RunningMedian::count() const noexcept
+{
+	return _lower.size() + _upper.size();
+}
+
+double RunningMedian::median() const noexcept
+{
+	if (_lower.empty())
+	{
+		return 0.0;
+	}
+
+	return _lower.size() > _upper.size() ? _lower.top() : (_lower.top() + _upper.top()) / 2.0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <functional>
+#include <queue>
+#include <vector>
+
+// Median of a growing sample in O(log n) per value: a max-heap holds the lower half and a min-heap the upper half,
+// with the lower half never smaller and at most one larger.
+class RunningMedian
+{
+public:
+	void add(double x);
+
+	unsigned count() const noexcept;
+
+	// the middle value, or the mean of the two middle values for an even count; 0 while empty
+	double median() const noexcept;
+
+private:
+	std::priority_queue<double> _lower;
+	std::priority_queue<double, std::vector<double>, std::greater<>> _upper;
+};
@@ -0,0 +1,32 @@
+#include "running_statistics.hpp"
+
+#include <cmath>
+
+void RunningStatistics::add(double x) noexcept
+{
+	++_count;
+
+	double delta = x - _mean;
+	_mean += delta / _count;
+	_sum_of_squares += delta * (x - _mean);
+}
+
+unsigned RunningStatistics::count() const noexcept
+{
+	return _count;
+}
+
+double RunningStatistics::mean() const noexcept
+{
+	return _mean;
+}
+
+double RunningStatistics::variance() const noexcept
+{
+	return _count < 2 ? 0.0 : _sum_of_squares / (_count - 1);
+}
+
+double RunningStatistics::standard_error() const noexcept
+{
+	return _count == 0 ? 0.0 : std::sqrt(variance() / _count);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Welford's streaming mean and variance: one pass, numerically stable, O(1) memory.
+// Fed with batch means, the batches being independent samples of the same distribution.
+class RunningStatistics
+{
+public:
+	void add(double x) noexcept;
+
+	unsigned count() const noexcept;
+
+	double mean() const noexcept;
+
+	// unbiased sample variance; 0 until there are two samples
+	double variance() const noexcept;
+
+	// standard error of the mean
+	double standard_error() const noexcept;
+
+private:
+	unsigned _count = 0;
+	double _mean = 0.0;
+	double _sum_of_squares = 0.0;
+};
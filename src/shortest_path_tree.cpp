@@ -0,0 +1,82 @@
+#include "shortest_path_tree.hpp"
+
+#include "original_graph.hpp"
+
+#include <routingkit/constants.h>
+
+#include <vector>
+
+void ShortestPathTree::grow(const OriginalGraph& reversed_graph, unsigned target, unsigned source) noexcept
+{
+	if (_epoch.size() != reversed_graph.size() || ++_current_epoch == 0)
+	{
+		_distance.assign(reversed_graph.size(), RoutingKit::inf_weight);
+		_next_hop.assign(reversed_graph.size(), RoutingKit::invalid_id);
+		_epoch.assign(reversed_graph.size(), 0);
+		_current_epoch = 1;
+	}
+
+	_queue = {};
+	_radius = RoutingKit::inf_weight;
+
+	_distance[target] = 0;
+	_next_hop[target] = target;
+	_epoch[target] = _current_epoch;
+	_queue.push({0, target});
+
+	while (!_queue.empty())
+	{
+		auto [distance, node] = _queue.top();
+		_queue.pop();
+
+		if (distance > _distance[node])
+		{
+			continue;
+		}
+
+		// greedy routing never moves farther from the target than the source
+		if (distance > _radius)
+		{
+			break;
+		}
+
+		if (node == source)
+		{
+			_radius = distance;
+		}
+
+		for (unsigned arc = reversed_graph.first_arc[node]; arc < reversed_graph.first_arc[node + 1]; ++arc)
+		{
+			unsigned tail = reversed_graph.other_end[arc];
+			unsigned new_distance = distance + reversed_graph.weight[arc];
+
+			if (_epoch[tail] != _current_epoch || new_distance < _distance[tail])
+			{
+				_epoch[tail] = _current_epoch;
+				_distance[tail] = new_distance;
+				_next_hop[tail] = node;
+				_queue.push({new_distance, tail});
+			}
+		}
+	}
+}
+
+unsigned ShortestPathTree::distance(unsigned node) const noexcept
+{
+	if (_epoch[node] != _current_epoch || _distance[node] > _radius)
+	{
+		return RoutingKit::inf_weight;
+	}
+
+	return _distance[node];
+}
+
+unsigned ShortestPathTree::next_hop(unsigned node) const noexcept
+{
+	if (distance(node) == RoutingKit::inf_weight)
+	{
+		return RoutingKit::invalid_id;
+	}
+
+	return _next_hop[node];
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "original_graph.hpp"
+
+#include <routingkit/constants.h>
+
+#include <queue>
+#include <vector>
+
+// Shortest path tree towards a single target, grown by a backward Dijkstra.
+// The workspace is epoch-stamped so that a thread_local tree can be regrown without clearing it.
+class ShortestPathTree
+{
+public:
+	// settles every node whose distance to target is at most the distance from source to target; without a source,
+	// every node that reaches target
+	void grow(const OriginalGraph& reversed_graph, unsigned target, unsigned source = RoutingKit::invalid_id) noexcept;
+
+	// inf_weight for nodes outside the tree: farther from the target than the source, or not reaching it at all
+	unsigned distance(unsigned node) const noexcept;
+
+	// invalid_id for nodes outside the tree
+	unsigned next_hop(unsigned node) const noexcept;
+
+private:
+	std::vector<unsigned> _distance;
+	std::vector<unsigned> _next_hop;
+	std::vector<unsigned> _epoch;
+	unsigned _current_epoch = 0;
+	unsigned _radius = 0;
+
+	std::priority_queue<std::pair<unsigned, unsigned>, std::vector<std::pair<unsigned, unsigned>>, std::greater<>> _queue;
+};
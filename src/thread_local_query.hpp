@@ -0,0 +1,22 @@
+#pragma once
+
+#include <routingkit/contraction_hierarchy.h>
+
+// The calling thread's CH query for call site SLOT. Pool workers outlive any one Highway, so the query is
+// kept across batches and only rebound when the thread moves on to a different hierarchy.
+template <unsigned SLOT>
+RoutingKit::ContractionHierarchyQuery& get_thread_local_query(const RoutingKit::ContractionHierarchy& ch) noexcept
+{
+	thread_local RoutingKit::ContractionHierarchyQuery query;
+	thread_local const RoutingKit::ContractionHierarchy* bound_ch = nullptr;
+	thread_local unsigned bound_node_count = 0;
+
+	if (bound_ch != &ch || bound_node_count != ch.node_count())
+	{
+		query.reset(ch);
+		bound_ch = &ch;
+		bound_node_count = ch.node_count();
+	}
+
+	return query;
+}
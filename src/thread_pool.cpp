@@ -0,0 +1,201 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// the pool whose worker runs on this thread, and that worker's index; nullptr and -1 outside every pool
+	thread_local const ThreadPool* current_pool = nullptr;
+	thread_local int current_worker = -1;
+
+	uint64_t pack(unsigned front, unsigned back) noexcept
+	{
+		return (uint64_t(back) << 32) | front;
+	}
+
+	unsigned front_of(uint64_t range) noexcept
+	{
+		return static_cast<unsigned>(range);
+	}
+
+	unsigned back_of(uint64_t range) noexcept
+	{
+		return static_cast<unsigned>(range >> 32);
+	}
+}
+
+ThreadPool& ThreadPool::instance()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::ThreadPool(unsigned num_threads)
+{
+	start(num_threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stop();
+}
+
+unsigned ThreadPool::size() const noexcept
+{
+	return _threads.size();
+}
+
+void ThreadPool::resize(unsigned num_threads)
+{
+	stop();
+	start(num_threads);
+}
+
+void ThreadPool::start(unsigned num_threads)
+{
+	num_threads = std::max(num_threads, 1u);
+
+	_stopping = false;
+	_blocks = std::make_unique<Block[]>(num_threads);
+
+	for (unsigned worker = 0; worker < num_threads; ++worker)
+	{
+		_blocks[worker].range = pack(0, 0);
+		_threads.emplace_back(&ThreadPool::work, this, worker, _generation);
+	}
+}
+
+void ThreadPool::stop()
+{
+	{
+		std::lock_guard lock(_mutex);
+		_stopping = true;
+	}
+
+	_job_ready.notify_all();
+
+	for (auto& thread : _threads)
+	{
+		thread.join();
+	}
+
+	_threads.clear();
+}
+
+void ThreadPool::parallel_for(unsigned num_items, unsigned chunk_size, const std::function<void(unsigned, unsigned, unsigned)>& body)
+{
+	if (num_items == 0)
+	{
+		return;
+	}
+
+	chunk_size = std::max(chunk_size, 1u);
+
+	// a worker of another pool submits to this one like any other thread
+	if (current_pool == this)
+	{
+		body(0, num_items, current_worker);
+		return;
+	}
+
+	// jobs submitted from several threads outside the pool run one after another
+	std::lock_guard submit_lock(_submit_mutex);
+
+	unsigned num_chunks = (num_items + chunk_size - 1) / chunk_size;
+	unsigned num_threads = size();
+
+	std::unique_lock lock(_mutex);
+
+	for (unsigned worker = 0; worker < num_threads; ++worker)
+	{
+		unsigned front = static_cast<uint64_t>(num_chunks) * worker / num_threads;
+		unsigned back = static_cast<uint64_t>(num_chunks) * (worker + 1) / num_threads;
+		_blocks[worker].range.store(pack(front, back), std::memory_order_relaxed);
+	}
+
+	_body = &body;
+	_num_items = num_items;
+	_chunk_size = chunk_size;
+	_num_busy = num_threads;
+	++_generation;
+
+	_job_ready.notify_all();
+	_job_done.wait(lock, [this]() { return _num_busy == 0; });
+
+	_body = nullptr;
+}
+
+bool ThreadPool::take_chunk(unsigned worker, unsigned& chunk) noexcept
+{
+	// own block first, from the front
+	auto& own = _blocks[worker].range;
+	uint64_t range = own.load(std::memory_order_acquire);
+
+	while (front_of(range) < back_of(range))
+	{
+		if (own.compare_exchange_weak(range, pack(front_of(range) + 1, back_of(range)), std::memory_order_acq_rel))
+		{
+			chunk = front_of(range);
+			return true;
+		}
+	}
+
+	// then steal from the back of the others'
+	for (unsigned offset = 1; offset < size(); ++offset)
+	{
+		auto& other = _blocks[(worker + offset) % size()].range;
+		range = other.load(std::memory_order_acquire);
+
+		while (front_of(range) < back_of(range))
+		{
+			if (other.compare_exchange_weak(range, pack(front_of(range), back_of(range) - 1), std::memory_order_acq_rel))
+			{
+				chunk = back_of(range) - 1;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::work(unsigned worker, uint64_t seen_generation)
+{
+	current_pool = this;
+	current_worker = worker;
+
+	while (true)
+	{
+		{
+			std::unique_lock lock(_mutex);
+			_job_ready.wait(lock, [&]() { return _stopping || _generation != seen_generation; });
+
+			if (_stopping)
+			{
+				return;
+			}
+
+			seen_generation = _generation;
+		}
+
+		unsigned chunk;
+		while (take_chunk(worker, chunk))
+		{
+			unsigned first = chunk * _chunk_size;
+			unsigned last = std::min(first + _chunk_size, _num_items);
+			(*_body)(first, last, worker);
+		}
+
+		std::lock_guard lock(_mutex);
+		if (--_num_busy == 0)
+		{
+			_job_done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// static const unsigned NUM_THREADS = 1;
+static const unsigned NUM_THREADS = std::thread::hardware_concurrency();
+
+// Process-wide pool of persistent workers. A parallel_for splits its items into chunks that are
+// dealt out in contiguous blocks, one per worker; a worker that runs out steals from the back of another's block.
+// Because the workers persist, their thread_local state (CH queries, search workspaces) survives between batches.
+class ThreadPool
+{
+public:
+	static ThreadPool& instance();
+
+	explicit ThreadPool(unsigned num_threads = NUM_THREADS);
+	~ThreadPool();
+
+	unsigned size() const noexcept;
+
+	// joins the current workers and starts num_threads new ones
+	void resize(unsigned num_threads);
+
+	// calls body(first, last, worker) on chunks [first, last) of [0, num_items) and waits for all of them;
+	// worker is in [0, size()). Called from inside one of this pool's workers, the whole range runs inline on that
+	// worker; called from several threads outside the pool at once (workers of other pools included), the jobs take turns.
+	void parallel_for(unsigned num_items, unsigned chunk_size, const std::function<void(unsigned, unsigned, unsigned)>& body);
+
+private:
+	// [front, back) of a worker's block of chunks, packed into one word so that the owner
+	// (taking from the front) and thieves (taking from the back) race on a single CAS
+	struct alignas(64) Block
+	{
+		std::atomic<uint64_t> range;
+	};
+
+	void start(unsigned num_threads);
+	void stop();
+
+	void work(unsigned worker, uint64_t seen_generation);
+	bool take_chunk(unsigned worker, unsigned& chunk) noexcept;
+
+	std::vector<std::thread> _threads;
+	std::unique_ptr<Block[]> _blocks;
+
+	std::mutex _submit_mutex;
+	std::mutex _mutex;
+	std::condition_variable _job_ready;
+	std::condition_variable _job_done;
+	uint64_t _generation = 0;
+	unsigned _num_busy = 0;
+	bool _stopping = false;
+
+	const std::function<void(unsigned, unsigned, unsigned)>* _body = nullptr;
+	unsigned _num_items = 0;
+	unsigned _chunk_size = 1;
+};
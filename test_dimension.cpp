@@ -51,11 +51,12 @@ int main()
 	// Lattice g(150, 3, true);
 	// Lattice g(150, 3, true);
 	Graph g = get_graph("HI");
+	ChainCompression compression(g);
 	// // // Graph g("CA");
 
 	// // printf("Num nodes: %u\n", g.size());
 	// // printf("Num edges: %u\n", g.num_edges());
 
-	double alpha = g.estimate_optimal_dimension(1.5, 0);
+	double alpha = compression.estimate_optimal_dimension(1.5, 0);
 	printf("Optimal alpha: %f\n", alpha);
 }
\ No newline at end of file